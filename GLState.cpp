@@ -0,0 +1,151 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/GLState.h"
+
+using namespace FX;
+using namespace fdm;
+
+GLState::Blend GLState::blend{ };
+const GLState::Blend GLState::defaultBlend{ };
+
+uint32_t* GLState::bufferBinding(GLenum target, uint32_t index)
+{
+	if (index >= BUFFER_BINDINGS) return nullptr;
+
+	switch (target)
+	{
+	case GL_SHADER_STORAGE_BUFFER: return &storageBuffers[index];
+	case GL_UNIFORM_BUFFER: return &uniformBuffers[index];
+	}
+	return nullptr;
+}
+
+void GLState::invalidate()
+{
+	framebuffer = UNKNOWN;
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	drawIndirectBuffer = UNKNOWN;
+	textures.fill(UNKNOWN);
+	storageBuffers.fill(UNKNOWN);
+	uniformBuffers.fill(UNKNOWN);
+	blendEnabledKnown = false;
+	blendEquationKnown = false;
+	blendFuncKnown = false;
+}
+
+void GLState::forgetBuffer(uint32_t buffer)
+{
+	if (!buffer) return;
+
+	if (drawIndirectBuffer == buffer) drawIndirectBuffer = UNKNOWN;
+	for (auto& binding : storageBuffers)
+		if (binding == buffer) binding = UNKNOWN;
+	for (auto& binding : uniformBuffers)
+		if (binding == buffer) binding = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(uint32_t vao)
+{
+	if (vao && vertexArray == vao) vertexArray = UNKNOWN;
+}
+
+void GLState::bindFramebuffer(uint32_t fbo, bool force)
+{
+	if (!force && framebuffer == fbo) return;
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	framebuffer = fbo;
+}
+
+void GLState::useProgram(uint32_t program, bool force)
+{
+	if (!force && GLState::program == program) return;
+	glUseProgram(program);
+	GLState::program = program;
+}
+
+void GLState::bindVertexArray(uint32_t vao, bool force)
+{
+	if (!force && vertexArray == vao) return;
+	glBindVertexArray(vao);
+	vertexArray = vao;
+}
+
+void GLState::bindDrawIndirectBuffer(uint32_t buffer, bool force)
+{
+	if (!force && drawIndirectBuffer == buffer) return;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	drawIndirectBuffer = buffer;
+}
+
+void GLState::bindTextureUnit(uint32_t unit, uint32_t texture, bool force)
+{
+	if (unit >= TEXTURE_UNITS)
+	{
+		glBindTextureUnit(unit, texture);
+		return;
+	}
+	if (!force && textures[unit] == texture) return;
+	glBindTextureUnit(unit, texture);
+	textures[unit] = texture;
+}
+
+void GLState::bindTextures(uint32_t first, uint32_t count, const uint32_t* textures)
+{
+	uint32_t changedFirst = UINT32_MAX, changedLast = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t unit = first + i;
+		if (unit < TEXTURE_UNITS && GLState::textures[unit] == textures[i]) continue;
+		changedFirst = glm::min(changedFirst, i);
+		changedLast = i;
+		if (unit < TEXTURE_UNITS)
+			GLState::textures[unit] = textures[i];
+	}
+	if (changedFirst == UINT32_MAX) return;
+
+	glBindTextures(first + changedFirst, changedLast - changedFirst + 1, textures + changedFirst);
+}
+
+void GLState::bindBufferBase(GLenum target, uint32_t index, uint32_t buffer, bool force)
+{
+	uint32_t* binding = bufferBinding(target, index);
+	if (!force && binding && *binding == buffer) return;
+	glBindBufferBase(target, index, buffer);
+	if (binding)
+		*binding = buffer;
+}
+
+void GLState::setBlendEnabled(bool enabled)
+{
+	if (blendEnabledKnown && blend.enabled == enabled) return;
+	if (enabled)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+	blend.enabled = enabled;
+	blendEnabledKnown = true;
+}
+
+void GLState::setBlend(const Blend& blend)
+{
+	setBlendEnabled(blend.enabled);
+	if (!blend.enabled) return;
+
+	if (!blendEquationKnown || GLState::blend.equationRGB != blend.equationRGB || GLState::blend.equationAlpha != blend.equationAlpha)
+	{
+		glBlendEquationSeparate(blend.equationRGB, blend.equationAlpha);
+		GLState::blend.equationRGB = blend.equationRGB;
+		GLState::blend.equationAlpha = blend.equationAlpha;
+		blendEquationKnown = true;
+	}
+	if (!blendFuncKnown || GLState::blend.srcRGB != blend.srcRGB || GLState::blend.dstRGB != blend.dstRGB ||
+		GLState::blend.srcAlpha != blend.srcAlpha || GLState::blend.dstAlpha != blend.dstAlpha)
+	{
+		glBlendFuncSeparate(blend.srcRGB, blend.dstRGB, blend.srcAlpha, blend.dstAlpha);
+		GLState::blend.srcRGB = blend.srcRGB;
+		GLState::blend.dstRGB = blend.dstRGB;
+		GLState::blend.srcAlpha = blend.srcAlpha;
+		GLState::blend.dstAlpha = blend.dstAlpha;
+		blendFuncKnown = true;
+	}
+}
@@ -0,0 +1,193 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/HiZ.h"
+
+#include <bit>
+
+using namespace FX;
+using namespace fdm;
+
+const FX::Shader* FX::HiZ::buildShader = nullptr;
+
+bool HiZ::Readback::isHidden(const glm::vec3& center, float radius) const
+{
+	if (depth.empty()) return false;
+
+	// the screen rect of the sphere's bounding box, in ndc
+	float left = 1e30f, right = -1e30f, bottom = 1e30f, top = -1e30f;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner = center + glm::vec3{ i & 1 ? radius : -radius, i & 2 ? radius : -radius, i & 4 ? radius : -radius };
+		glm::vec4 clip = projection * glm::vec4{ corner, 1.0f };
+		if (clip.w <= 0.0f) return false;
+		left = glm::min(left, clip.x / clip.w);
+		right = glm::max(right, clip.x / clip.w);
+		bottom = glm::min(bottom, clip.y / clip.w);
+		top = glm::max(top, clip.y / clip.w);
+	}
+	if (right < -1.0f || top < -1.0f || left > 1.0f || bottom > 1.0f) return true;
+
+	// the camera looks down -z
+	glm::vec4 nearest = projection * glm::vec4{ center.x, center.y, center.z + radius, 1.0f };
+	float nearestDepth = nearest.z / nearest.w * 0.5f + 0.5f;
+
+	auto texel = [](float ndc, int size) { return glm::clamp((int)glm::floor((ndc * 0.5f + 0.5f) * size), 0, size - 1); };
+	float farthest = 0.0f;
+	for (int y = texel(bottom, height); y <= texel(top, height); ++y)
+		for (int x = texel(left, width); x <= texel(right, width); ++x)
+			farthest = glm::max(farthest, depth[y * width + x].y);
+
+	return nearestDepth > farthest;
+}
+
+void HiZ::enable(Framebuffer& fb, bool cull)
+{
+	pyramids.try_emplace(&fb);
+	if (cull)
+		cullTarget = &fb;
+}
+
+void HiZ::disable(Framebuffer& fb)
+{
+	cleanup(fb);
+	pyramids.erase(&fb);
+	if (cullTarget != &fb) return;
+
+	cullTarget = nullptr;
+	std::lock_guard lock{ readbackMutex };
+	readback = nullptr;
+}
+
+uint32_t HiZ::getTexture(const Framebuffer& fb)
+{
+	auto it = pyramids.find(&fb);
+	return it != pyramids.end() ? it->second.tex : 0;
+}
+
+glm::ivec2 HiZ::getSize(const Framebuffer& fb)
+{
+	auto it = pyramids.find(&fb);
+	return it != pyramids.end() ? glm::ivec2{ it->second.width, it->second.height } : glm::ivec2{ 0 };
+}
+
+void HiZ::setProjection(const glm::mat4& projection)
+{
+	HiZ::projection = projection;
+	hasProjection = true;
+}
+
+bool HiZ::getProjection(glm::mat4& projection)
+{
+	projection = HiZ::projection;
+	return hasProjection;
+}
+
+uint32_t HiZ::getCullTexture(int& levels)
+{
+	auto it = cullTarget ? pyramids.find(cullTarget) : pyramids.end();
+	if (it == pyramids.end()) return 0;
+	levels = it->second.levels;
+	return it->second.tex;
+}
+
+std::shared_ptr<const HiZ::Readback> HiZ::getReadback()
+{
+	std::lock_guard lock{ readbackMutex };
+	return readback;
+}
+
+void HiZ::finishReadback()
+{
+	if (!readbackFence) return;
+
+	GLenum status = glClientWaitSync(readbackFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+	glDeleteSync(readbackFence);
+	readbackFence = nullptr;
+
+	if (!hasProjection) return;
+
+	auto result = std::make_shared<Readback>();
+	result->width = pendingSize.x;
+	result->height = pendingSize.y;
+	result->depth.resize(pendingSize.x * pendingSize.y);
+	result->projection = projection;
+	glGetNamedBufferSubData(readbackBuffer, 0, result->depth.size() * sizeof(glm::vec2), result->depth.data());
+
+	std::lock_guard lock{ readbackMutex };
+	readback = std::move(result);
+}
+
+void HiZ::startReadback(const Pyramid& pyramid)
+{
+	// the last one is still on its way
+	if (readbackFence) return;
+
+	int level = 0;
+	while (level < pyramid.levels - 1 && glm::max(pyramid.width >> level, pyramid.height >> level) > readbackSize)
+		++level;
+	glm::ivec2 size{ glm::max(pyramid.width >> level, 1), glm::max(pyramid.height >> level, 1) };
+	size_t bytes = size.x * size.y * sizeof(glm::vec2);
+
+	if (!readbackBuffer)
+		glCreateBuffers(1, &readbackBuffer);
+	if (size != pendingSize)
+		glNamedBufferData(readbackBuffer, bytes, nullptr, GL_STREAM_READ);
+	pendingSize = size;
+
+	// there's no DSA version of reading into a pack buffer
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	glGetTextureImage(pyramid.tex, level, GL_RG, GL_FLOAT, bytes, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void HiZ::build(const Framebuffer& fb, uint32_t depthTex, int width, int height)
+{
+	auto it = pyramids.find(&fb);
+	if (it == pyramids.end() || !depthTex || !ShaderLoader::isReady(buildShader)) return;
+
+	Pyramid& pyramid = it->second;
+	width = glm::max(width / 2, 1);
+	height = glm::max(height / 2, 1);
+	if (pyramid.width != width || pyramid.height != height)
+	{
+		RenderTargetPool::release(pyramid.tex);
+		pyramid.width = width;
+		pyramid.height = height;
+		pyramid.levels = std::bit_width((uint32_t)glm::max(width, height));
+		pyramid.tex = RenderTargetPool::acquire(width, height, GL_RG32F, pyramid.levels);
+	}
+
+	uint32_t program = buildShader->id();
+	GLState::useProgram(program);
+	GLState::bindTextureUnit(0, depthTex);
+	buildShader->setUniform("depth", 0);
+	int fromDepth = buildShader->getUniformLocation("fromDepth");
+	for (int level = 0; level < pyramid.levels; ++level)
+	{
+		buildShader->setUniform(fromDepth, level == 0);
+		glBindImageTexture(0, pyramid.tex, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+		if (level)
+			glBindImageTexture(1, pyramid.tex, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+		glDispatchCompute((glm::max(width >> level, 1) + 7) / 8, (glm::max(height >> level, 1) + 7) / 8, 1);
+		// the next level reads this one
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	// sampled by passes and culling, and copied by the readback
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	if (&fb == cullTarget)
+	{
+		finishReadback();
+		startReadback(pyramid);
+	}
+}
+
+void HiZ::cleanup(const Framebuffer& fb)
+{
+	auto it = pyramids.find(&fb);
+	if (it == pyramids.end()) return;
+
+	RenderTargetPool::release(it->second.tex);
+	it->second = Pyramid{};
+}
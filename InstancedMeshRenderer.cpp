@@ -25,7 +25,8 @@ void InstancedMeshRenderer::updateMesh(const Mesh* mesh)
 	{
 		assert(mesh->buffCount() == bufferCount);
 
-		glBindVertexArray(VAO);
+		// the shadow can't see the VAOs 4D Miner bound since the last draw
+		GLState::bindVertexArray(VAO, true);
 		initAttrs(mesh);
 
 		vertexCount = mesh->vertCount();
@@ -41,7 +42,7 @@ void InstancedMeshRenderer::updateMesh(const Mesh* mesh)
 		}
 
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		GLState::bindVertexArray(0, true);
 	}
 	else
 	{
@@ -60,23 +61,39 @@ void InstancedMeshRenderer::render() const
 {
 	if (!instanceCount) return;
 
-	glBindVertexArray(VAO);
+	GLState::invalidate();
 
-	SSBO.use(0);
+	GLState::bindVertexArray(VAO);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO.id());
 
 	if (indexVBO)
-	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
 		glDrawElementsInstanced(mode, vertexCount, GL_UNSIGNED_INT, 0, instanceCount);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	}
 	else
-	{
 		glDrawArraysInstanced(mode, 0, vertexCount, instanceCount);
-	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// game code binding an element buffer without its own VAO would replace the index buffer in this one
+	GLState::bindVertexArray(0);
+}
+
+std::array<uint32_t, 5> InstancedMeshRenderer::getIndirectCommand() const
+{
+	return { (uint32_t)vertexCount, 0, 0, 0, 0 };
+}
+
+void InstancedMeshRenderer::renderIndirect(uint32_t instances, uint32_t commandBuffer) const
+{
+	GLState::invalidate();
+
+	GLState::bindVertexArray(VAO);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instances);
+	GLState::bindDrawIndirectBuffer(commandBuffer);
+
+	if (indexVBO)
+		glDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr);
+	else
+		glDrawArraysIndirect(mode, nullptr);
+
+	GLState::bindVertexArray(0);
 }
 
 void InstancedMeshRenderer::updateData(const std::vector<void*>& instanceData)
@@ -114,7 +131,7 @@ void InstancedMeshRenderer::init(const Mesh* mesh)
 	cleanup();
 
 	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO, true);
 
 	bufferCount = mesh->buffCount();
 
@@ -131,17 +148,15 @@ void InstancedMeshRenderer::init(const Mesh* mesh)
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffSize(), data, GL_STATIC_DRAW);
 	}
 
+	// unbinding the index buffer with the VAO bound would take it out of the VAO
+	GLState::bindVertexArray(0, true);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
 void InstancedMeshRenderer::cleanup()
 {
 	if (VAO)
 	{
-		glBindVertexArray(VAO);
-
 		glDeleteBuffers(bufferCount, VBOs);
 		delete VBOs;
 		VBOs = NULL;
@@ -149,6 +164,7 @@ void InstancedMeshRenderer::cleanup()
 		glDeleteBuffers(1, &indexVBO);
 		indexVBO = NULL;
 
+		GLState::forgetVertexArray(VAO);
 		glDeleteVertexArrays(1, &VAO);
 		VAO = NULL;
 
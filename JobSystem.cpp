@@ -0,0 +1,128 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/JobSystem.h"
+
+using namespace FX;
+
+// index of the deque owned by the current thread. outside threads share the last one
+static thread_local size_t currentDeque = SIZE_MAX;
+
+bool JobSystem::Deque::push(const Task& task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (tail - head == CAPACITY)
+		return false;
+	tasks[tail++ % CAPACITY] = task;
+	return true;
+}
+
+bool JobSystem::Deque::pop(Task& task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (tail == head)
+		return false;
+	task = tasks[--tail % CAPACITY];
+	return true;
+}
+
+bool JobSystem::Deque::steal(Task& task)
+{
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if (!lock.owns_lock() || tail == head)
+		return false;
+	task = tasks[head++ % CAPACITY];
+	return true;
+}
+
+JobSystem& JobSystem::get()
+{
+	static JobSystem instance;
+	return instance;
+}
+
+JobSystem::JobSystem()
+{
+	size_t threads = glm::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	dequeCount = threads + 1;
+	deques = std::make_unique<Deque[]>(dequeCount);
+
+	workers.reserve(threads);
+	for (size_t i = 0; i < threads; ++i)
+		workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void JobSystem::execute(Task& task)
+{
+	task.invoke(task.storage);
+	task.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::submit(const Task& task)
+{
+	size_t home = currentDeque < dequeCount ? currentDeque : dequeCount - 1;
+
+	queued.fetch_add(1, std::memory_order_release);
+	if (!deques[home].push(task))
+	{
+		// the deque is full, so there is plenty of work queued already
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		Task copy = task;
+		execute(copy);
+		return;
+	}
+
+	// a worker checks `queued` under this lock before sleeping, so it can't miss the notification
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::runOne(size_t home)
+{
+	Task task;
+	bool found = home < dequeCount && deques[home].pop(task);
+	for (size_t i = 1; !found && i <= dequeCount; ++i)
+		found = deques[(home + i) % dequeCount].steal(task);
+
+	if (!found) return false;
+
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	execute(task);
+	return true;
+}
+
+void JobSystem::workerLoop(size_t index)
+{
+	currentDeque = index;
+
+	while (!stop)
+	{
+		if (runOne(index)) continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stop || queued.load(std::memory_order_acquire) > 0; });
+	}
+}
+
+void JobSystem::wait(Counter& counter)
+{
+	size_t home = currentDeque < dequeCount ? currentDeque : dequeCount - 1;
+
+	while (!counter.done())
+	{
+		if (!runOne(home))
+			std::this_thread::yield();
+	}
+}
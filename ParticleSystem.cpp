@@ -5,13 +5,14 @@ using namespace FX;
 using namespace fdm;
 
 const FX::Shader* FX::ParticleSystem::defaultShader = nullptr;
+const FX::Shader* FX::ParticleSystem::cullShader = nullptr;
 
 ParticleSystem::ParticleSystem(const glm::vec4& origin, RND<float> lifetime, ParticleSpace particleSpace, size_t maxParticles)
 	: origin(origin),
 	lifetime(lifetime),
 	particleSpace(particleSpace),
 	maxParticles(maxParticles),
-	trailRenderer(500, maxParticles)
+	trailRenderer(500, 0)
 {
 	trailRenderer.user = this;
 	trailRenderer.billboard = true;
@@ -56,7 +57,7 @@ ParticleSystem::ParticleSystem(
 	angleTowardsVelocity(angleTowardsVelocity),
 	particleSpace(particleSpace),
 	maxParticles(maxParticles),
-	trailRenderer(500, maxParticles)
+	trailRenderer(500, 0)
 {
 	trailRenderer.user = this;
 	trailRenderer.billboard = true;
@@ -94,7 +95,7 @@ ParticleSystem::ParticleSystem(
 	angleTowardsVelocity(angleTowardsVelocity),
 	particleSpace(particleSpace),
 	maxParticles(maxParticles),
-	trailRenderer(500, maxParticles)
+	trailRenderer(500, 0)
 {
 	trailRenderer.user = this;
 	trailRenderer.billboard = true;
@@ -111,15 +112,58 @@ void ParticleSystem::initRenderer(const Mesh* mesh, const fdm::Shader* particleS
 	trailRenderer.initRenderer();
 }
 
+void ParticleSystem::syncTrails()
+{
+	// trails are only created once they are used
+	if ((trails || trailRenderer.getTrailsCount()) && trailRenderer.getTrailsCount() != maxParticles)
+		trailRenderer.setTrailsCount(maxParticles);
+}
+
 void ParticleSystem::update(double dt)
 {
+	sync();
+
+	if (!asyncUpdate)
+	{
+		simulate(dt);
+		return;
+	}
+
+	// `render` may change `lastView` and `hasView` while the job runs
+	jobView = lastView;
+	const bool jobHasView = hasView;
+	updatePending = true;
+	JobSystem::get().run(updateJob, [this, dt, jobHasView]()
+		{
+			simulate(dt);
+			backData.assign(gpuData.begin(), gpuData.begin() + particles.size());
+			if (trails && jobHasView)
+				trailRenderer.buildMesh(jobView);
+		});
+}
+
+void ParticleSystem::sync()
+{
+	if (!updatePending) return;
+
+	JobSystem::get().wait(updateJob);
+	updatePending = false;
+
+	std::swap(frontData, backData);
+	trailRenderer.swapMesh();
+}
+
+void ParticleSystem::simulate(double dt)
+{
+	syncTrails();
+
+	// remove the dead particles first, so the rest can be updated independently
 	for (size_t i = 0; i < particles.size();)
 	{
 		Particle& p = particles[i];
 		ParticleData& pData = gpuData[i];
 		if (p.time <= p.lifetime)
 		{
-			updateParticle(p, pData, i, dt);
 			++i;
 		}
 		else
@@ -131,6 +175,16 @@ void ParticleSystem::update(double dt)
 			particles.pop_back();
 		}
 	}
+
+	auto updateRange = [this, dt](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			updateParticle(particles[i], gpuData[i], i, dt);
+	};
+
+	if (!evalFunc || evalFuncThreadSafe)
+		JobSystem::get().parallelFor(0, particles.size(), updateRange);
+	else
+		updateRange(0, particles.size());
 	if (trails)
 	{
 		trailRenderer.update();
@@ -139,35 +193,75 @@ void ParticleSystem::update(double dt)
 
 void ParticleSystem::render(const m4::Mat5& view)
 {
-	if (trails)
+	lastView = view;
+	hasView = true;
+
+	GLState::invalidate();
+
+	if (trails && ShaderLoader::isReady(trailShader))
 	{
-		trailRenderer.updateMesh(
-			glm::vec4(view[0][0], view[1][0], view[2][0], view[3][0]),
-			glm::vec4(view[0][1], view[1][1], view[2][1], view[3][1]),
-			glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]),
-			glm::vec4(view[0][3], view[1][3], view[2][3], view[3][3]));
-		trailShader->use();
+		if (asyncUpdate)
+			trailRenderer.uploadMesh();
+		else
+			trailRenderer.updateMesh(view);
+		GLState::useProgram(trailShader->id());
 		((const FX::Shader*)trailShader)->setUniform("MV", view); // compat
 		((const FX::Shader*)trailShader)->setUniform("view", view);
 		trailRenderer.setMode(GL_LINES_ADJACENCY);
 		trailRenderer.render();
 	}
 
-	particleShader->use();
+	if (!ShaderLoader::isReady(particleShader)) return;
+
+	size_t count = asyncUpdate ? frontData.size() : particles.size();
+	renderer.updateData(asyncUpdate ? frontData.data() : gpuData.data(), count);
+
+	int hiZLevels = 0;
+	uint32_t hiZ = occlusionCulling ? HiZ::getCullTexture(hiZLevels) : 0;
+	glm::mat4 projection{ 1 };
+	const bool cull = hiZ && count && ShaderLoader::isReady(cullShader) && HiZ::getProjection(projection);
+	if (cull)
+	{
+		visibleSSBO.fit(count * sizeof(ParticleData));
+		auto command = renderer.getIndirectCommand();
+		commandSSBO.uploadData(sizeof(command), command.data());
+
+		GLState::useProgram(cullShader->id());
+		cullShader->setUniform("count", (uint32_t)count);
+		cullShader->setUniform("view", view);
+		cullShader->setUniform("P", projection);
+		cullShader->setUniform("margin", cullMargin);
+		cullShader->setUniform("hiZ", 0);
+		cullShader->setUniform("hiZLevels", hiZLevels);
+		GLState::bindTextureUnit(0, hiZ);
+		GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, renderer.SSBO.id());
+		GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleSSBO.id());
+		GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandSSBO.id());
+		glDispatchCompute((count + 63) / 64, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+
+	GLState::useProgram(particleShader->id());
 	((const FX::Shader*)particleShader)->setUniform("MV", view); // compat
 	((const FX::Shader*)particleShader)->setUniform("view", view);
 	((const FX::Shader*)particleShader)->setUniform("billboard", billboard);
-	renderer.updateData(gpuData.data(), particles.size());
-	renderer.render();
+	if (cull)
+		renderer.renderIndirect(visibleSSBO.id(), commandSSBO.id());
+	else
+		renderer.render();
 }
 
 ParticleSystem::Particle* ParticleSystem::emit(size_t count)
 {
+	sync();
+
 	int cCount = glm::min(count, maxParticles - particles.size());
 
 	if (cCount == 0)
 		return nullptr;
 
+	syncTrails();
+
 	for (int i = 0; i < cCount; i++)
 	{
 		Particle& p = particles.emplace_back();
@@ -234,11 +328,13 @@ ParticleSystem::Particle* ParticleSystem::emit(size_t count)
 
 void ParticleSystem::setMaxParticles(size_t maxParticles)
 {
+	sync();
+
 	this->maxParticles = maxParticles;
 
 	particles.reserve(maxParticles);
 	gpuData.resize(maxParticles);
-	trailRenderer.setTrailsCount(maxParticles);
+	syncTrails();
 
 	if (particles.size() > maxParticles)
 	{
@@ -249,6 +345,8 @@ void ParticleSystem::setMaxParticles(size_t maxParticles)
 
 ParticleSystem& ParticleSystem::operator=(const ParticleSystem& other)
 {
+	sync();
+
 	this->particleShader = other.particleShader;
 	this->trailShader = other.trailShader;
 	this->origin = other.origin;
@@ -272,10 +370,14 @@ ParticleSystem& ParticleSystem::operator=(const ParticleSystem& other)
 	this->particles = other.particles;
 	this->gpuData = other.gpuData;
 	this->evalFunc = other.evalFunc;
+	this->evalFuncThreadSafe = other.evalFuncThreadSafe;
+	this->asyncUpdate = other.asyncUpdate;
 	this->emitFunc = other.emitFunc;
 	this->user = other.user;
 	this->trailRenderer = other.trailRenderer;
 	this->trails = other.trails;
+	this->occlusionCulling = other.occlusionCulling;
+	this->cullMargin = other.cullMargin;
 	trailRenderer.user = this;
 
 	setMaxParticles(maxParticles);
@@ -285,6 +387,9 @@ ParticleSystem& ParticleSystem::operator=(const ParticleSystem& other)
 
 ParticleSystem& ParticleSystem::operator=(ParticleSystem&& other) noexcept
 {
+	sync();
+	other.sync();
+
 	this->particleShader = other.particleShader;
 	this->trailShader = other.trailShader;
 	this->origin = other.origin;
@@ -308,10 +413,14 @@ ParticleSystem& ParticleSystem::operator=(ParticleSystem&& other) noexcept
 	this->particles = other.particles;
 	this->gpuData = other.gpuData;
 	this->evalFunc = other.evalFunc;
+	this->evalFuncThreadSafe = other.evalFuncThreadSafe;
+	this->asyncUpdate = other.asyncUpdate;
 	this->emitFunc = other.emitFunc;
 	this->user = other.user;
 	this->trailRenderer = other.trailRenderer;
 	this->trails = other.trails;
+	this->occlusionCulling = other.occlusionCulling;
+	this->cullMargin = other.cullMargin;
 	trailRenderer.user = this;
 
 	other.particleShader = nullptr;
@@ -337,10 +446,14 @@ ParticleSystem& ParticleSystem::operator=(ParticleSystem&& other) noexcept
 	other.particles.clear();
 	other.gpuData.clear();
 	other.evalFunc = nullptr;
+	other.evalFuncThreadSafe = false;
+	other.asyncUpdate = false;
 	other.emitFunc = nullptr;
 	other.user = nullptr;
 	other.trailRenderer.setTrailsCount(0);
 	other.trails = false;
+	other.occlusionCulling = false;
+	other.cullMargin = 0.f;
 
 	setMaxParticles(maxParticles);
 
@@ -0,0 +1,130 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/PostFX.h"
+
+using namespace FX;
+using namespace fdm;
+
+// a pass shader from assets/shaders/postfx, with `defines` added after the version line.
+// every set of defines is its own program, named after them
+static const fdm::Shader* loadShader(const std::string& name, const std::vector<std::pair<std::string, std::string>>& defines = {})
+{
+	std::string fullName = std::format("tr1ngledev.fxlib.postfx.{}", name);
+	for (auto& [define, value] : defines)
+		fullName += std::format(".{}={}", define, value);
+
+	if (const FX::Shader* shader = ShaderLoader::get(fullName))
+		return (const fdm::Shader*)shader;
+
+	std::string vertex, fragment;
+	std::string fragmentPath = std::format("assets/shaders/postfx/{}.frag", name);
+	if (!ShaderLoader::readFile("assets/shaders/pass.vert", vertex) || !ShaderLoader::readFile(fragmentPath, fragment))
+	{
+		logWarning(std::format("couldn't read \"{}\"", fragmentPath));
+		return nullptr;
+	}
+
+	ShaderPatcher patcher{ fragment };
+	for (auto& [define, value] : defines)
+		patcher.define(define, value);
+
+	return (const fdm::Shader*)ShaderLoader::loadFromSource(fullName, { { GL_VERTEX_SHADER, vertex }, { GL_FRAGMENT_SHADER, patcher.getSource() } });
+}
+
+// the kawase passes of one mip chain group. `first` is the sizeDiv exponent of the first pass, `last` of the last one
+static PostPassGroup kawaseGroup(const fdm::Shader* shader, int first, int last, float& offset)
+{
+	PostPassGroup group{};
+	int step = first <= last ? 1 : -1;
+	for (int level = first; level != last + step; level += step)
+		group.passes.emplace_back(shader, 1 << level);
+	group.uniforms.push_back({ Uniform::FLOAT, "offset", &offset });
+	group.mipChain.mode = PostPassGroup::MipChain::PASSES;
+	// every pass draws its whole target
+	group.clearColor = false;
+	return group;
+}
+
+void PostFX::addThreshold(std::vector<PostPassGroup>& groups, Threshold& settings, int sizeDiv)
+{
+	const fdm::Shader* shader = sizeDiv > 1 ? loadShader("threshold", { { "DOWNSAMPLE", "" } }) : loadShader("threshold");
+
+	PostPassGroup& group = groups.emplace_back(PostPass{ shader, sizeDiv });
+	group.uniforms.push_back({ Uniform::FLOAT, "threshold", &settings.threshold });
+	group.uniforms.push_back({ Uniform::FLOAT, "knee", &settings.knee });
+}
+
+void PostFX::addKawaseBlur(std::vector<PostPassGroup>& groups, KawaseBlur& settings)
+{
+	int levels = glm::max(settings.levels, 1);
+
+	// down into levels 1...n, then up into n-1...0
+	groups.emplace_back(kawaseGroup(loadShader("kawase_down"), 1, levels, settings.offset));
+	groups.emplace_back(kawaseGroup(loadShader("kawase_up"), levels - 1, 0, settings.offset));
+}
+
+void PostFX::addGaussianBlur(std::vector<PostPassGroup>& groups, const GaussianBlur& settings)
+{
+	int radius = glm::max(settings.radius, 1);
+	float sigma = glm::max(radius / 3.0f, 0.5f);
+
+	std::vector<float> kernel(radius + 2, 0.0f); // one past the end, so pairs never read out of bounds
+	float total = 0.0f;
+	for (int i = 0; i <= radius; ++i)
+	{
+		kernel[i] = glm::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+		total += i ? kernel[i] * 2.0f : kernel[i];
+	}
+
+	// texel i and i + 1 become one tap, placed between them by their weights
+	std::string offsets = "float[](0.0", weights = std::format("float[]({:.8f}", kernel[0] / total);
+	int taps = 1;
+	for (int i = 1; i <= radius; i += 2, ++taps)
+	{
+		float weight = kernel[i] + kernel[i + 1];
+		offsets += std::format(", {:.8f}", (i * kernel[i] + (i + 1) * kernel[i + 1]) / weight);
+		weights += std::format(", {:.8f}", weight / total);
+	}
+	offsets += ")";
+	weights += ")";
+
+	auto shader = [&](const char* direction)
+		{
+			return loadShader("gaussian", {
+				{ "TAPS", std::to_string(taps) },
+				{ "OFFSETS", offsets },
+				{ "WEIGHTS", weights },
+				{ "DIRECTION", direction } });
+		};
+
+	// the kernel's offsets are in texels of the blur's resolution, so a smaller blur gets its input at that resolution first
+	std::vector<PostPass> passes;
+	if (settings.sizeDiv > 1)
+		passes.emplace_back(loadShader("downsample"), settings.sizeDiv);
+	passes.emplace_back(shader("vec2(1.0, 0.0)"), settings.sizeDiv);
+	passes.emplace_back(shader("vec2(0.0, 1.0)"), settings.sizeDiv);
+	groups.emplace_back(std::move(passes));
+}
+
+void PostFX::addBloom(std::vector<PostPassGroup>& groups, Bloom& settings)
+{
+	int levels = glm::max(settings.levels, 2);
+	// the scene is the output of the group before the bloom, 3 groups back from the composite
+	bool first = groups.empty();
+
+	// threshold into level 1 and down to n
+	PostPassGroup& down = groups.emplace_back(kawaseGroup(loadShader("kawase_down"), 1, levels, settings.offset));
+	down.passes.front().shader = loadShader("threshold", { { "DOWNSAMPLE", "" } });
+	down.uniforms.push_back({ Uniform::FLOAT, "threshold", &settings.threshold.threshold });
+	down.uniforms.push_back({ Uniform::FLOAT, "knee", &settings.threshold.knee });
+	// only the colors of the chains are used, and they never go negative
+	for (auto& pass : down.passes)
+		pass.passFormat = PostPass::R11F_G11F_B10F;
+
+	// up from n to 1, adding the down chain
+	PostPassGroup& up = groups.emplace_back(kawaseGroup(loadShader("kawase_up", { { "BLOOM", "" } }), levels - 1, 1, settings.offset));
+	for (auto& pass : up.passes)
+		pass.passFormat = PostPass::R11F_G11F_B10F;
+
+	PostPassGroup& composite = groups.emplace_back(PostPass{ first ? loadShader("bloom_composite") : loadShader("bloom_composite", { { "SCENE", "ppp_group" } }) });
+	composite.uniforms.push_back({ Uniform::FLOAT, "intensity", &settings.intensity });
+}
@@ -10,40 +10,77 @@ void PostPass::initTexture(int width, int height)
 
 	this->width = width;
 	this->height = height;
-	GLenum internalFormat = 0;
-	GLenum format = 0;
-	GLenum formatType = GL_FLOAT;
+	targetTex = RenderTargetPool::acquire(width, height, getInternalFormat(getFormat()));
+}
+
+GLenum PostPass::getInternalFormat(decltype(passFormat) format)
+{
+	switch (format)
+	{
+	case FX::PostPass::R: return GL_R16F;
+	case FX::PostPass::RG: return GL_RG16F;
+	case FX::PostPass::RGB: return GL_RGB16F;
+	case FX::PostPass::R11F_G11F_B10F: return GL_R11F_G11F_B10F;
+	case FX::PostPass::RGB10_A2: return GL_RGB10_A2;
+	case FX::PostPass::RGBA8: return GL_RGBA8;
+	case FX::PostPass::R8: return GL_R8;
+	}
+	return GL_RGBA16F;
+}
+
+decltype(PostPass::passFormat) PostPass::getFormat() const
+{
+	if (passFormat != AUTO) return passFormat;
+
+	switch (glm::clamp(channels, 1, 4))
+	{
+	case 1: return range == LDR ? R8 : R;
+	// there's no 2 channel 8 bit format to pick
+	case 2: return RG;
+	case 3: return range == LDR ? RGB10_A2 : range == POSITIVE_HDR ? R11F_G11F_B10F : RGB;
+	}
+	return range == LDR ? RGBA8 : RGBA;
+}
+
+uint32_t Uniform::getSize() const
+{
+	switch (type)
+	{
+	case VEC2: case IVEC2: case UVEC2: return 8;
+	case VEC3: case IVEC3: case UVEC3: return 12;
+	case VEC4: case IVEC4: case UVEC4: return 16;
+	}
+	return 4;
+}
 
-	switch (passFormat)
+uint32_t Uniform::getAlignment() const
+{
+	switch (type)
 	{
-	case FX::PostPass::R:
-		internalFormat = GL_R16F;
-		format = GL_RED;
-		break;
-	case FX::PostPass::RG:
-		internalFormat = GL_RG16F;
-		format = GL_RG;
-		break;
-	case FX::PostPass::RGB:
-		internalFormat = GL_RGB16F;
-		format = GL_RGB;
-		break;
-	case FX::PostPass::RGBA:
-		internalFormat = GL_RGBA16F;
-		format = GL_RGBA;
-		break;
+	case VEC2: case IVEC2: case UVEC2: return 8;
+	case VEC3: case IVEC3: case UVEC3:
+	case VEC4: case IVEC4: case UVEC4: return 16;
 	}
+	return 4;
+}
 
+const char* Uniform::getTypeName() const
+{
+	switch (type)
 	{
-		glGenTextures(1, &targetTex);
-		glBindTexture(GL_TEXTURE_2D, targetTex);
-		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, formatType, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	case VEC2: return "vec2";
+	case VEC3: return "vec3";
+	case VEC4: return "vec4";
+	case INT: return "int";
+	case IVEC2: return "ivec2";
+	case IVEC3: return "ivec3";
+	case IVEC4: return "ivec4";
+	case UINT: return "uint";
+	case UVEC2: return "uvec2";
+	case UVEC3: return "uvec3";
+	case UVEC4: return "uvec4";
 	}
+	return "float";
 }
 
 PostPass::PostPass(PostPass&& other) noexcept
@@ -54,6 +91,8 @@ PostPass::PostPass(PostPass&& other) noexcept
 	this->height = other.height;
 	this->sizeDiv = other.sizeDiv;
 	this->passFormat = other.passFormat;
+	this->channels = other.channels;
+	this->range = other.range;
 
 	other.shader = nullptr;
 	other.targetTex = 0;
@@ -61,6 +100,8 @@ PostPass::PostPass(PostPass&& other) noexcept
 	other.height = 1;
 	other.sizeDiv = 1;
 	other.passFormat = RGBA;
+	other.channels = 4;
+	other.range = HDR;
 }
 
 PostPass& PostPass::operator=(PostPass&& other) noexcept
@@ -73,6 +114,8 @@ PostPass& PostPass::operator=(PostPass&& other) noexcept
 		this->height = other.height;
 		this->sizeDiv = other.sizeDiv;
 		this->passFormat = other.passFormat;
+		this->channels = other.channels;
+		this->range = other.range;
 
 		other.shader = nullptr;
 		other.targetTex = 0;
@@ -80,6 +123,8 @@ PostPass& PostPass::operator=(PostPass&& other) noexcept
 		other.height = 1;
 		other.sizeDiv = 1;
 		other.passFormat = RGBA;
+		other.channels = 4;
+		other.range = HDR;
 	}
 
 	return *this;
@@ -92,6 +137,8 @@ PostPass::PostPass(const PostPass& other)
 	this->height = other.height;
 	this->sizeDiv = other.sizeDiv;
 	this->passFormat = other.passFormat;
+	this->channels = other.channels;
+	this->range = other.range;
 }
 
 PostPass& PostPass::operator=(const PostPass& other)
@@ -101,6 +148,8 @@ PostPass& PostPass::operator=(const PostPass& other)
 	this->height = other.height;
 	this->sizeDiv = other.sizeDiv;
 	this->passFormat = other.passFormat;
+	this->channels = other.channels;
+	this->range = other.range;
 
 	return *this;
 }
@@ -109,7 +158,7 @@ void PostPass::cleanup()
 {
 	if (targetTex)
 	{
-		glDeleteTextures(1, &targetTex);
+		RenderTargetPool::release(targetTex);
 		targetTex = 0;
 
 		width = 1;
@@ -127,7 +176,56 @@ const fdm::Shader* PostPass::loadPassShader(const stl::string& name, const stl::
 	if (ShaderManager::shaders.contains(name))
 		return ShaderManager::get(name);
 
-	return ShaderManager::load(name, "assets/shaders/pass.vert", std::format("../../{}", fragmentPath));
+	return (const fdm::Shader*)ShaderLoader::loadAsync(name, "assets/shaders/pass.vert", std::format("../../{}", fragmentPath));
+}
+
+const fdm::Shader* PostPass::loadPassShader(const stl::string& name, const stl::string& fragmentPath, const std::vector<Uniform>& uniforms)
+{
+	if (ShaderManager::shaders.contains(name))
+		return ShaderManager::get(name);
+	if (const FX::Shader* shader = ShaderLoader::get(name))
+		return (const fdm::Shader*)shader;
+
+	std::string vertex, fragment;
+	if (!ShaderLoader::readFile("assets/shaders/pass.vert", vertex) || !ShaderLoader::readFile(std::format("../../{}", fragmentPath), fragment))
+	{
+		logWarning(std::format("couldn't read \"{}\"", fragmentPath));
+		return nullptr;
+	}
+
+	std::string source = ShaderPatcher{ fragment }.addLine(PostPassGroup::getUniformBlock(uniforms)).getSource();
+	return (const fdm::Shader*)ShaderLoader::loadFromSource(name, { { GL_VERTEX_SHADER, vertex }, { GL_FRAGMENT_SHADER, source } });
+}
+
+const fdm::Shader* PostPass::loadComputePassShader(const stl::string& name, const stl::string& computePath)
+{
+	return (const fdm::Shader*)ShaderLoader::loadComputeAsync(name, std::format("../../{}", computePath));
+}
+
+uint32_t PostPassGroup::getUniformLayout(const std::vector<Uniform>& uniforms, std::vector<uint32_t>& offsets)
+{
+	offsets.clear();
+	uint32_t size = 0;
+	for (auto& uniform : uniforms)
+	{
+		uint32_t alignment = uniform.getAlignment();
+		size = (size + alignment - 1) / alignment * alignment;
+		offsets.emplace_back(size);
+		size += uniform.getSize();
+	}
+	// blocks are a multiple of a vec4
+	return (size + 15) / 16 * 16;
+}
+
+std::string PostPassGroup::getUniformBlock(const std::vector<Uniform>& uniforms)
+{
+	std::string block = std::format("layout(std140) uniform {}\n{{\n", UNIFORM_BLOCK);
+	for (auto& uniform : uniforms)
+		block += std::format("\t{} {};\n", uniform.getTypeName(), uniform.name);
+	// an empty block isn't valid GLSL
+	if (uniforms.empty())
+		block += "\tvec4 _unused;\n";
+	return block + "};";
 }
 
 PostPassGroup::~PostPassGroup()
@@ -154,7 +252,9 @@ PostPassGroup::PostPassGroup(PostPassGroup&& other) noexcept
 	this->targetFBO = other.targetFBO;
 	this->outputTex = other.outputTex;
 	this->copyLastGroup = other.copyLastGroup;
+	this->readLastGroup = other.readLastGroup;
 	this->clearColor = other.clearColor;
+	this->mipChain = other.mipChain;
 	this->preDrawCallback = other.preDrawCallback;
 	this->postDrawCallback = other.postDrawCallback;
 
@@ -167,7 +267,9 @@ PostPassGroup::PostPassGroup(PostPassGroup&& other) noexcept
 	other.targetFBO = 0;
 	other.outputTex = 0;
 	other.copyLastGroup = false;
+	other.readLastGroup = false;
 	other.clearColor = true;
+	other.mipChain = {};
 	other.preDrawCallback = nullptr;
 	other.postDrawCallback = nullptr;
 }
@@ -184,7 +286,9 @@ PostPassGroup& PostPassGroup::operator=(PostPassGroup&& other) noexcept
 		this->targetFBO = other.targetFBO;
 		this->outputTex = other.outputTex;
 		this->copyLastGroup = other.copyLastGroup;
+		this->readLastGroup = other.readLastGroup;
 		this->clearColor = other.clearColor;
+		this->mipChain = other.mipChain;
 		this->preDrawCallback = other.preDrawCallback;
 		this->postDrawCallback = other.postDrawCallback;
 
@@ -197,7 +301,9 @@ PostPassGroup& PostPassGroup::operator=(PostPassGroup&& other) noexcept
 		other.targetFBO = 0;
 		other.outputTex = 0;
 		other.copyLastGroup = false;
+		other.readLastGroup = false;
 		other.clearColor = true;
+		other.mipChain = {};
 		other.preDrawCallback = nullptr;
 		other.postDrawCallback = nullptr;
 	}
@@ -214,7 +320,9 @@ PostPassGroup::PostPassGroup(const PostPassGroup& other)
 	this->iteration = other.iteration;
 	this->blending = other.blending;
 	this->copyLastGroup = other.copyLastGroup;
+	this->readLastGroup = other.readLastGroup;
 	this->clearColor = other.clearColor;
+	this->mipChain = other.mipChain;
 	this->preDrawCallback = other.preDrawCallback;
 	this->postDrawCallback = other.postDrawCallback;
 }
@@ -227,7 +335,9 @@ PostPassGroup& PostPassGroup::operator=(const PostPassGroup& other)
 	this->iteration = other.iteration;
 	this->blending = other.blending;
 	this->copyLastGroup = other.copyLastGroup;
+	this->readLastGroup = other.readLastGroup;
 	this->clearColor = other.clearColor;
+	this->mipChain = other.mipChain;
 	this->preDrawCallback = other.preDrawCallback;
 	this->postDrawCallback = other.postDrawCallback;
 
@@ -1,5 +1,7 @@
 #include "include/fxlib/FXLib.h"
 
+#include <bit>
+
 using namespace FX;
 using namespace fdm;
 
@@ -21,6 +23,7 @@ struct
 } passRenderer;
 static TexRenderer fbRenderer{};
 static Tex2D fbRendererTex{};
+static const FX::Shader* upscaleShader = nullptr;
 
 class FB
 {
@@ -40,6 +43,113 @@ public:
 };
 
 inline static std::set<FB*> framebuffers{};
+inline static std::unordered_map<FB*, GLenum> colorFormats{}; // set by setFramebufferFormat
+
+// everything a frame of post-processing needs, resolved once from the pass groups.
+// rebuilt when the groups, their shaders' readiness or the framebuffer size change
+struct PlanStep
+{
+	uint32_t program = 0;
+	uint32_t fbo = 0; // framebuffer with the step's target attached
+	int width = 1, height = 1;
+	// compute passes write their target as image unit 0 instead
+	bool compute = false;
+	uint32_t image = 0;
+	int imageLevel = 0;
+	GLenum imageFormat = 0;
+	glm::uvec2 groups{ 1 };
+	std::vector<uint32_t> textures{ }; // bound to units 0, 1, 2...
+	std::vector<std::pair<int, const uint32_t*>> userTextures{ }; // unit -> PostPassGroup::uniformTextures value
+	std::vector<std::pair<int, int>> samplers{ }; // location -> unit
+	std::vector<std::pair<int, glm::vec4>> sizes{ }; // location -> size
+	std::vector<std::pair<int, const Uniform*>> uniforms{ };
+};
+struct PlanBlit
+{
+	uint32_t srcFBO = 0, dstFBO = 0;
+	int srcWidth = 1, srcHeight = 1, dstWidth = 1, dstHeight = 1;
+};
+struct PlanGroup
+{
+	size_t group = 0;
+	std::vector<PlanBlit> blits{ };
+	std::vector<PlanStep> steps{ };
+	uint32_t generateMips = 0; // mip chain texture to glGenerateTextureMipmap after the steps
+	// the group's uniforms packed as std140, for the passes with PostPassGroup::UNIFORM_BLOCK
+	uint32_t uniformBuffer = 0;
+	std::vector<uint32_t> uniformOffsets{ };
+	uint32_t uniformSize = 0;
+	std::vector<uint8_t> uniformData{ }; // what the buffer holds, empty until the first upload
+};
+// the output brought back to full size when the groups run below it
+struct PlanUpscale
+{
+	uint32_t program = 0;
+	uint32_t fbo = 0;
+	uint32_t input = 0;
+};
+struct Plan
+{
+	uint64_t signature = 0;
+	std::vector<PlanGroup> groups{ };
+	PlanUpscale upscale{ };
+	std::unordered_map<uint64_t, uint32_t> fbos{ }; // texture | level << 32 -> framebuffer
+	std::vector<uint32_t> textures{ }; // shared by passes whose contents are needed at different times, and by other framebuffers
+	std::vector<uint32_t> views{ }; // one per mip chain level, so passes can sample a single level
+	uint32_t outputTex = 0;
+};
+inline static std::unordered_map<FB*, Plan> plans{};
+inline static constexpr uint32_t UNIFORM_BINDING = 0;
+
+// dynamic resolution of a framebuffer
+struct Scaling
+{
+	inline static constexpr int FRAMES = 4; // timings in flight, so reading one never waits for the GPU
+
+	DynamicResolution settings{ };
+	float scale = 1.0f;
+	float gpuMs = 0.0f; // averaged
+	int samples = 0; // since the scale last changed
+	uint32_t queries[FRAMES][2]{ }; // GL_TIMESTAMPs before and after the pass groups
+	bool pending[FRAMES]{ };
+	int frame = 0;
+};
+inline static std::unordered_map<FB*, Scaling> scalings{};
+
+// the size the pass groups run at
+static glm::ivec2 scaledSize(FB* s)
+{
+	auto it = scalings.find(s);
+	if (it == scalings.end() || !it->second.settings.enabled)
+		return { s->width, s->height };
+	float scale = it->second.scale;
+	return { glm::max((int)glm::round(s->width * scale), 1), glm::max((int)glm::round(s->height * scale), 1) };
+}
+
+static void deleteQueries(Scaling& scaling)
+{
+	if (scaling.queries[0][0])
+		glDeleteQueries(Scaling::FRAMES * 2, &scaling.queries[0][0]);
+	std::fill(&scaling.queries[0][0], &scaling.queries[0][0] + Scaling::FRAMES * 2, 0);
+	std::fill(scaling.pending, scaling.pending + Scaling::FRAMES, false);
+}
+
+static void destroyPlan(Plan& plan)
+{
+	for (auto& [tex, fbo] : plan.fbos)
+		glDeleteFramebuffers(1, &fbo);
+	for (uint32_t tex : plan.textures)
+		RenderTargetPool::release(tex);
+	if (!plan.views.empty())
+		glDeleteTextures(plan.views.size(), plan.views.data());
+	for (auto& group : plan.groups)
+	{
+		if (!group.uniformBuffer) continue;
+		GLState::forgetBuffer(group.uniformBuffer);
+		glDeleteBuffers(1, &group.uniformBuffer);
+	}
+	plan = Plan{};
+}
 
 $hook(void, Framebuffer, cleanup)
 {
@@ -52,10 +162,10 @@ $hook(void, Framebuffer, cleanup)
 		glDeleteFramebuffers(1, &s->fbo);
 		s->fbo = NULL;
 
-		glDeleteTextures(1, &s->colorTex);
+		RenderTargetPool::release(s->colorTex);
 		s->colorTex = NULL;
 
-		glDeleteTextures(1, &s->depthTex);
+		RenderTargetPool::release(s->depthTex);
 		s->depthTex = NULL;
 
 		s->width = 1;
@@ -69,6 +179,17 @@ $hook(void, Framebuffer, cleanup)
 		s->passGroups = nullptr;
 	}
 
+	if (auto it = plans.find(s); it != plans.end())
+	{
+		destroyPlan(it->second);
+		plans.erase(it);
+	}
+
+	// the settings outlive resizes, the queries don't
+	if (auto it = scalings.find(s); it != scalings.end())
+		deleteQueries(it->second);
+	HiZ::cleanup(*self);
+
 	framebuffers.erase(s);
 }
 
@@ -78,7 +199,10 @@ $hook(void, Framebuffer, destr_Framebuffer)
 	if (s->_magic_number != MAGIC_NUMBER)
 		return original(self);
 
-	return self->cleanup();
+	self->cleanup();
+	scalings.erase(s);
+	colorFormats.erase(s);
+	HiZ::disable(*self);
 }
 
 $hook(void, Framebuffer, init, GLsizei width, GLsizei height, bool alphaChannel)
@@ -88,7 +212,8 @@ $hook(void, Framebuffer, init, GLsizei width, GLsizei height, bool alphaChannel)
 		return original(self, width, height, alphaChannel);
 
 	uint32_t internalFormat = alphaChannel ? GL_RGBA16F : GL_RGB16F;
-	uint32_t format = alphaChannel ? GL_RGBA : GL_RGB;
+	if (auto it = colorFormats.find(s); it != colorFormats.end())
+		internalFormat = it->second;
 
 	if (s->width == width && s->height == height && s->alphaChannel == alphaChannel)
 		return;
@@ -103,426 +228,950 @@ $hook(void, Framebuffer, init, GLsizei width, GLsizei height, bool alphaChannel)
 
 	glCreateFramebuffers(1, &s->fbo);
 
-	{
-		glGenTextures(1, &s->colorTex);
-		glBindTexture(GL_TEXTURE_2D, s->colorTex);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_FLOAT, nullptr); // 4dm actually does GL_UNSIGNED_BYTE but i changed it to GL_FLOAT for hdr ig idk
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT); // 4dm doesn't even set this lol
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT); // 4dm doesn't even set this lol
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glNamedFramebufferTexture(s->fbo, GL_COLOR_ATTACHMENT0, s->colorTex, 0);
-	}
+	// 4dm actually does GL_UNSIGNED_BYTE but it's half floats here for hdr.
+	// linear filtering and mirrored repeat come from the pool (4dm doesn't even set the wrapping lol)
+	s->colorTex = RenderTargetPool::acquire(width, height, internalFormat);
+	glNamedFramebufferTexture(s->fbo, GL_COLOR_ATTACHMENT0, s->colorTex, 0);
 
-	{
-		glGenTextures(1, &s->depthTex);
-		glBindTexture(GL_TEXTURE_2D, s->depthTex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glNamedFramebufferTexture(s->fbo, GL_DEPTH_ATTACHMENT, s->depthTex, 0);
-	}
+	s->depthTex = RenderTargetPool::acquire(width, height, GL_DEPTH_COMPONENT24);
+	glNamedFramebufferTexture(s->fbo, GL_DEPTH_ATTACHMENT, s->depthTex, 0);
 
 	framebuffers.insert(s);
 
 	for (auto& callback : s->initCallbacks) callback(s->fbo, s->colorTex, s->depthTex, s->width, s->height, *s->passGroups);
 }
 
-$hook(void, Framebuffer, render)
+// FNV-1a over everything the plan depends on. cheap enough to check every frame
+static uint64_t planSignature(FB* s)
 {
-	FB* s = (FB*)self;
-	if (s->_magic_number != MAGIC_NUMBER)
-		return original(self);
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto add = [&hash](auto v)
+		{
+			const uint8_t* bytes = (const uint8_t*)&v;
+			for (size_t i = 0; i < sizeof(v); ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 0x100000001B3ull;
+			}
+		};
 
-	uint32_t outputID = s->colorTex;
 	auto& passGroups = *s->passGroups;
-	if (!passGroups.empty())
+	add(s->width);
+	add(s->height);
+	glm::ivec2 scaled = scaledSize(s);
+	add(scaled);
+	add(HiZ::getTexture(*(Framebuffer*)s));
+	if (scaled != glm::ivec2{ s->width, s->height })
+		add(ShaderLoader::isReady(upscaleShader));
+	add(passGroups.data());
+	add(passGroups.size());
+	for (auto& group : passGroups)
 	{
-		int fb = NULL;
-		int blendEquationRGB = NULL;
-		int blendEquationA = NULL;
-		int blendSrcRGB = NULL;
-		int blendSrcA = NULL;
-		int blendDstRGB = NULL;
-		int blendDstA = NULL;
-		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fb);
-		glGetIntegerv(GL_BLEND_EQUATION_RGB, &blendEquationRGB);
-		glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &blendEquationA);
-		glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRGB);
-		glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcA);
-		glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRGB);
-		glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstA);
+		add(group.passes.data());
+		add(group.passes.size());
+		add(group.uniforms.data());
+		add(group.uniforms.size());
+		add(group.uniformTextures.size());
+		add(group.viewportMode);
+		add(group.iteration.dir);
+		add(group.iteration.count);
+		add(group.copyLastGroup);
+		// culling and aliasing depend on these too
+		add(group.clearColor);
+		add(group.preDrawCallback);
+		add(group.postDrawCallback);
+		add(group.readLastGroup);
+		add(group.mipChain.mode);
+		add(group.mipChain.levels);
+		for (auto& pass : group.passes)
+		{
+			add(pass.shader);
+			add(ShaderLoader::isReady(pass.shader));
+			add(pass.sizeDiv);
+			add(pass.getFormat());
+			add(pass.targetTex);
+		}
+	}
 
-		glDisable(GL_ALPHA_TEST);
-		for (int i = 0; i < passGroups.size(); ++i)
+	return hash ? hash : 1;
+}
+
+static void buildPlan(FB* s, Plan& plan)
+{
+	destroyPlan(plan);
+
+	auto& passGroups = *s->passGroups;
+
+	int maxUnits = 0;
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxUnits);
+
+	const glm::ivec2 scaled = scaledSize(s);
+	auto passSize = [scaled](const PostPass& pass) { return glm::ivec2{ glm::max(scaled.x / pass.sizeDiv, 1), glm::max(scaled.y / pass.sizeDiv, 1) }; };
+	auto sizeOf = [](glm::ivec2 size) { return glm::vec4{ size.x, size.y, 1.0f / size.x, 1.0f / size.y }; };
+	auto fboOf = [&plan](std::pair<uint32_t, int> target) -> uint32_t
+		{
+			auto [tex, level] = target;
+			if (!tex) return 0;
+			uint32_t& fbo = plan.fbos[tex | ((uint64_t)level << 32)];
+			if (!fbo)
+			{
+				glCreateFramebuffers(1, &fbo);
+				glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, tex, level);
+			}
+			return fbo;
+		};
+
+	// which groups get drawn, and the steps (pass, prev, next) of each
+	struct Order { size_t group; std::vector<glm::ivec3> steps; };
+	std::vector<Order> order;
+	// passes that get rendered or blitted to, so they have a texture
+	std::unordered_set<const PostPass*> targets;
+	for (size_t i = 0; i < passGroups.size(); ++i)
+	{
+		PostPassGroup& group = passGroups[i];
+		if (group.passes.empty()) continue;
+		// shaders still compiling in the background. the group is left out until they are done
+		if (!std::all_of(group.passes.begin(), group.passes.end(), [](const PostPass& pass) { return ShaderLoader::isReady(pass.shader); }))
+			continue;
+
+		if (!group.targetFBO)
+			glCreateFramebuffers(1, &group.targetFBO);
+
+		using enum PostPassGroup::PassIteration::Count;
+		using enum PostPassGroup::PassIteration::Direction;
+		int count = group.passes.size();
+		int last = count - (group.iteration.count == SKIP_LAST ? 2 : 1);
+		int first = (group.iteration.count == SKIP_FIRST ? 1 : 0);
+
+		Order& o = order.emplace_back(Order{ i });
+		if (group.iteration.dir == FORWARD)
+			for (int j = first; j <= last; ++j)
+				o.steps.push_back({ j, glm::clamp(j - 1, 0, count - 1), glm::clamp(j + 1, 0, count - 1) });
+		else
+			for (int j = last; j >= first; --j)
+				o.steps.push_back({ j, glm::clamp(j + 1, 0, count - 1), glm::clamp(j - 1, 0, count - 1) });
+
+		if (group.copyLastGroup)
+			for (auto& pass : group.passes)
+				targets.insert(&pass);
+		for (auto& step : o.steps)
+		{
+			switch (group.viewportMode)
+			{
+			case PostPassGroup::CURRENT_PASS_SIZE: targets.insert(&group.passes[step.x]); break;
+			case PostPassGroup::PREV_PASS_SIZE: targets.insert(&group.passes[step.y]); break;
+			case PostPassGroup::NEXT_PASS_SIZE: targets.insert(&group.passes[step.z]); break;
+			}
+		}
+	}
+
+	// mip chain groups get one texture with a level per pass, and a single level view of each level
+	struct Chain
+	{
+		uint32_t tex = 0;
+		decltype(PostPass::passFormat) format = PostPass::RGBA;
+		std::vector<uint32_t> views;
+	};
+	std::unordered_map<size_t, Chain> chains;
+	std::unordered_map<const PostPass*, std::pair<size_t, int>> mipLevels; // pass -> group, level
+	for (auto& o : order)
+	{
+		PostPassGroup& group = passGroups[o.group];
+		if (group.mipChain.mode == PostPassGroup::MipChain::DISABLED || group.passes.empty()) continue;
+
+		int fullLevels = std::bit_width((uint32_t)glm::max(scaled.x, scaled.y));
+		std::vector<int> passLevels;
+		for (auto& pass : group.passes)
+		{
+			if (pass.sizeDiv < 1 || !std::has_single_bit((uint32_t)pass.sizeDiv)) break;
+			// anything smaller than 1x1 is the last level, which is 1x1 too
+			int level = glm::min(std::countr_zero((uint32_t)pass.sizeDiv), fullLevels - 1);
+			if (std::find(passLevels.begin(), passLevels.end(), level) != passLevels.end()) break;
+			passLevels.emplace_back(level);
+		}
+		if (passLevels.size() != group.passes.size())
+		{
+			logWarning(std::format("mip chain passes need different power of 2 sizeDivs, drawing group {} without one", o.group));
+			continue;
+		}
+
+		// the texture starts at the biggest level a pass draws into, so no level above it is allocated
+		const int base = *std::min_element(passLevels.begin(), passLevels.end());
+		int end = *std::max_element(passLevels.begin(), passLevels.end()) + 1;
+		if (group.mipChain.mode == PostPassGroup::MipChain::GENERATE)
+			end = glm::max(end, group.mipChain.levels > 0 ? glm::min(base + group.mipChain.levels, fullLevels) : fullLevels);
+		const int levels = end - base;
+		for (int& level : passLevels)
+			level -= base;
+
+		Chain& chain = chains[o.group];
+		chain.format = group.passes.front().getFormat();
+		GLenum internalFormat = PostPass::getInternalFormat(chain.format);
+		chain.tex = RenderTargetPool::acquire(glm::max(scaled.x >> base, 1), glm::max(scaled.y >> base, 1), internalFormat, levels);
+		plan.textures.emplace_back(chain.tex);
+
+		chain.views.resize(levels);
+		glGenTextures(levels, chain.views.data());
+		for (int level = 0; level < levels; ++level)
+		{
+			glTextureView(chain.views[level], GL_TEXTURE_2D, chain.tex, internalFormat, level, 1, 0, 1);
+			glTextureParameteri(chain.views[level], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		}
+		plan.views.insert(plan.views.end(), chain.views.begin(), chain.views.end());
+
+		for (size_t j = 0; j < group.passes.size(); ++j)
+			mipLevels[&group.passes[j]] = { o.group, passLevels[j] };
+	}
+
+	// a pass' texture or a plain one. pass textures are only resolved once culling and aliasing are decided
+	struct Ref
+	{
+		const PostPass* pass = nullptr;
+		uint32_t tex = 0;
+	};
+	auto texSize = [&](const PostPass& pass) { return targets.contains(&pass) ? passSize(pass) : glm::ivec2{ pass.width, pass.height }; };
+	auto refTexSize = [&](const Ref& ref) { return ref.pass ? texSize(*ref.pass) : glm::ivec2{ s->width, s->height }; };
+	auto outputOf = [&](size_t i) -> Ref
 		{
 			PostPassGroup& group = passGroups[i];
-			if (group.passes.empty()) continue;
+			using enum PostPassGroup::PassIteration::Count;
+			int index = group.iteration.dir == PostPassGroup::PassIteration::FORWARD
+				? (int)group.passes.size() - (group.iteration.count == SKIP_LAST ? 2 : 1)
+				: (group.iteration.count == SKIP_FIRST ? 1 : 0);
+			return { &group.passes[index] };
+		};
+
+	struct DraftStep
+	{
+		PlanStep step;
+		const PostPass* target = nullptr;
+		std::vector<Ref> textures;
+		std::vector<bool> read; // per unit, whether an active sampler uses it
+		int position = 0;
+	};
+	struct DraftBlit
+	{
+		PlanBlit blit;
+		Ref src; // no pass and no texture for the framebuffer itself
+		const PostPass* dst = nullptr;
+		int position = 0;
+	};
+	struct DraftGroup
+	{
+		size_t group = 0;
+		bool uniformBlock = false; // a pass has the group's uniform block
+		std::vector<DraftBlit> blits;
+		std::vector<DraftStep> steps;
+	};
+	std::vector<DraftGroup> drafts;
+
+	std::unordered_map<size_t, Ref> groupOutputs;
+	Ref outputID{ nullptr, s->colorTex };
+	int prevGroupIndex = -1; // the last group that gets drawn
+	int position = 0;
+	for (auto& o : order)
+	{
+		const int i = o.group;
+		PostPassGroup& group = passGroups[i];
+		DraftGroup& draft = drafts.emplace_back();
+		draft.group = i;
+
+		if (group.copyLastGroup)
+		{
+			int j = 0;
+			for (auto& pass : group.passes)
+			{
+				DraftBlit& blit = draft.blits.emplace_back();
+				glm::ivec2 size = passSize(pass);
+				blit.dst = &pass;
+				blit.blit.dstWidth = size.x;
+				blit.blit.dstHeight = size.y;
+				blit.position = position++;
+				if (prevGroupIndex < 0)
+				{
+					blit.blit.srcWidth = s->width;
+					blit.blit.srcHeight = s->height;
+				}
+				else
+				{
+					PostPassGroup& prevGroup = passGroups[prevGroupIndex];
+					PostPass& gPass = prevGroup.passes[glm::clamp(j, 0, (int)prevGroup.passes.size() - 1)];
+					glm::ivec2 gSize = passSize(gPass);
+					blit.src = { &gPass };
+					blit.blit.srcWidth = gSize.x;
+					blit.blit.srcHeight = gSize.y;
+				}
+				++j;
+			}
+		}
 
-			if (!group.targetFBO)
+		// with readLastGroup, passes of this group not drawn yet are read from the last group
+		const bool readLast = group.readLastGroup && !group.copyLastGroup;
+		std::unordered_set<const PostPass*> drawn;
+		auto lastGroupPass = [&](int l) -> std::pair<Ref, glm::vec4>
 			{
-				glCreateFramebuffers(1, &group.targetFBO);
+				if (prevGroupIndex < 0)
+					return { Ref{ nullptr, s->colorTex }, sizeOf({ s->width, s->height }) };
+				PostPassGroup& prevGroup = passGroups[prevGroupIndex];
+				const PostPass& gPass = prevGroup.passes[glm::clamp(l, 0, (int)prevGroup.passes.size() - 1)];
+				return { Ref{ &gPass }, sizeOf(texSize(gPass)) };
+			};
+
+		for (auto& indices : o.steps)
+		{
+			const int ind = indices.x, prevInd = indices.y, nextInd = indices.z;
+			PostPass& prevPass = group.passes[prevInd];
+			PostPass& pass = group.passes[ind];
+			PostPass& nextPass = group.passes[nextInd];
+			const uint32_t program = pass.shader->id();
+
+			PostPass* target = &pass;
+			switch (group.viewportMode)
+			{
+			case PostPassGroup::PREV_PASS_SIZE: target = &prevPass; break;
+			case PostPassGroup::NEXT_PASS_SIZE: target = &nextPass; break;
 			}
+			const bool compute = ShaderLoader::isCompute(pass.shader);
+			const auto targetFormat = mipLevels.contains(target) ? chains[i].format : target->getFormat();
+			if (compute && targetFormat == PostPass::RGB)
+			{
+				logWarning(std::format("compute passes can't write RGB targets (there is no rgb16f image format), skipping one of group {}", i));
+				continue;
+			}
+
+			DraftStep& draftStep = draft.steps.emplace_back();
+			PlanStep& step = draftStep.step;
+			step.program = program;
+			draftStep.position = position++;
+
+			glm::ivec2 targetSize = passSize(*target);
+			draftStep.target = target;
+			step.width = targetSize.x;
+			step.height = targetSize.y;
 
-			if (group.copyLastGroup)
+			if (compute)
 			{
-				int j = 0;
-				for (auto& pass : group.passes)
+				int localSize[3]{ 1, 1, 1 };
+				glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, localSize);
+				step.compute = true;
+				step.imageFormat = PostPass::getInternalFormat(targetFormat);
+				step.groups = { (targetSize.x + localSize[0] - 1) / localSize[0], (targetSize.y + localSize[1] - 1) / localSize[1] };
+			}
+
+			auto bind = [&](Ref ref) { draftStep.textures.emplace_back(ref); draftStep.read.emplace_back(false); };
+			// a unit only counts as read when the program has the sampler active
+			auto sampler = [&](const char* name, int unit)
 				{
-					int passWidth = glm::max(s->width / pass.sizeDiv, 1);
-					int passHeight = glm::max(s->height / pass.sizeDiv, 1);
-					if (pass.targetTex == 0 || pass.width != passWidth || pass.height != passHeight)
-						pass.initTexture(passWidth, passHeight);
-					glNamedFramebufferTexture(group.targetFBO, GL_COLOR_ATTACHMENT0, pass.targetTex, 0);
-					if (i - 1 < 0)
-					{
-						glBlitNamedFramebuffer(s->fbo, group.targetFBO, 0, 0, s->width, s->height, 0, 0, passWidth, passHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-					}
-					else
+					int loc = glGetProgramResourceLocation(program, GL_UNIFORM, name);
+					if (loc == -1) return;
+					step.samplers.emplace_back(loc, unit);
+					if (unit < draftStep.read.size())
+						draftStep.read[unit] = true;
+				};
+			auto size = [&](const char* name, const glm::vec4& value)
+				{
+					int loc = glGetProgramResourceLocation(program, GL_UNIFORM, name);
+					if (loc != -1)
+						step.sizes.emplace_back(loc, value);
+				};
+
+			bind({ nullptr, s->colorTex });
+			bind({ nullptr, s->depthTex });
+			bind(outputID);
+			sampler("source", 0);
+			sampler("sourceDepth", 1);
+			sampler("prevPassGroup", 2);
+			size("sourceSize", sizeOf({ s->width, s->height }));
+			if (compute)
+				size("targetSize", sizeOf(targetSize));
+
+			int j = 0;
+			for (int l = 0; l < group.passes.size(); ++l)
+			{
+				const PostPass& otherPass = group.passes[l];
+				const bool inPlace = readLast && !drawn.contains(&otherPass);
+				if (!inPlace && !targets.contains(&otherPass) && !otherPass.targetTex) continue;
+				auto [ref, refSize] = inPlace ? lastGroupPass(l) : std::pair{ Ref{ &otherPass }, sizeOf(texSize(otherPass)) };
+				bind(ref);
+				sampler(std::format("pass{}", l).c_str(), j + 3);
+				size(std::format("pass{}_size", l).c_str(), refSize);
+				if (l == prevInd && ind != prevInd)
+				{
+					sampler("prevPass", j + 3);
+					size("prevPass_size", refSize);
+				}
+				if (l == ind)
+				{
+					sampler("curPass", j + 3);
+					size("curPass_size", refSize);
+				}
+				if (l == nextInd && ind != nextInd)
+				{
+					sampler("nextPass", j + 3);
+					size("nextPass_size", refSize);
+				}
+				++j;
+			}
+			// fallback prevPass to outputID (prevPassGroup/default)
+			if (ind == prevInd)
+			{
+				bind(outputID);
+				sampler("prevPass", j + 3);
+				size("prevPass_size", sizeOf(refTexSize(outputID)));
+				++j;
+			}
+
+			for (auto& tex : group.uniformTextures)
+			{
+				bind({ nullptr, tex.second });
+				step.userTextures.emplace_back(j + 3, &tex.second);
+				sampler(tex.first.c_str(), j + 3);
+				++j;
+			}
+
+			for (int k = 0; k < i; ++k)
+			{
+				const PostPassGroup& _group = passGroups[k];
+				int k_ = i - k;
+				std::string prefix = std::string(k_, 'p');
+				std::string name = std::format("{}_group", prefix);
+				bind(groupOutputs.contains(k) ? groupOutputs[k] : Ref{ nullptr, _group.outputTex });
+				sampler(name.c_str(), j + 3);
+				++j;
+				int l = 0;
+				for (auto& p : _group.passes)
+				{
+					bind({ &p });
+					// the size and index names use the next pass' number, like they always have
+					sampler(std::format("{}_pass{}", name, l++).c_str(), j + 3);
+					size(std::format("{}_pass{}_size", name, l).c_str(), sizeOf(texSize(p)));
+					if (l == ind)
 					{
-						PostPassGroup& prevGroup = passGroups[i - 1];
-						PostPass& gPass = prevGroup.passes[glm::clamp(j, 0, (int)prevGroup.passes.size() - 1)];
-						int gPassWidth = glm::max(s->width / gPass.sizeDiv, 1);
-						int gPassHeight = glm::max(s->height / gPass.sizeDiv, 1);
-						glNamedFramebufferTexture(prevGroup.targetFBO, GL_COLOR_ATTACHMENT0, gPass.targetTex, 0);
-						glBlitNamedFramebuffer(prevGroup.targetFBO, group.targetFBO, 0, 0, gPassWidth, gPassHeight, 0, 0, passWidth, passHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+						sampler(std::format("{}_passInd", name).c_str(), j + 3);
+						size(std::format("{}_passInd_size", name).c_str(), sizeOf(texSize(p)));
 					}
 					++j;
 				}
 			}
+			sampler(std::format("{}_group", std::string(i + 1, 'p')).c_str(), 0);
+
+			// whole mip chains of earlier groups, after everything else so the units above don't move.
+			// a group's own chain isn't bound: with one of its levels as the target that's a feedback loop, whatever level is read
+			for (int k = 0; k < i; ++k)
+			{
+				if (!chains.contains(k)) continue;
+				bind({ nullptr, chains[k].tex });
+				sampler(std::format("{}_group_chain", std::string(i - k, 'p')).c_str(), j + 3);
+				++j;
+			}
+			if (uint32_t hiZ = HiZ::getTexture(*(Framebuffer*)s))
+			{
+				bind({ nullptr, hiZ });
+				sampler("hiZ", j + 3);
+				glm::ivec2 hiZSize = HiZ::getSize(*(Framebuffer*)s);
+				size("hiZ_size", sizeOf(hiZSize));
+				++j;
+			}
+
+			// uniforms inside the block have no location, so they're only set one by one for passes without it
+			for (auto& uniform : group.uniforms)
+			{
+				int loc = glGetProgramResourceLocation(program, GL_UNIFORM, uniform.name.c_str());
+				if (loc != -1)
+					step.uniforms.emplace_back(loc, &uniform);
+			}
+			uint32_t block = glGetProgramResourceIndex(program, GL_UNIFORM_BLOCK, PostPassGroup::UNIFORM_BLOCK);
+			if (block != GL_INVALID_INDEX)
+			{
+				glUniformBlockBinding(program, block, UNIFORM_BINDING);
+				draft.uniformBlock = true;
+			}
+
+			drawn.insert(target);
+		}
+
+		outputID = groupOutputs[i] = outputOf(i);
+		prevGroupIndex = i;
+	}
+
+	// cull the steps nothing reads from. group outputs are public and groups with callbacks may read anything,
+	// so those always stay
+	std::unordered_set<const PostPass*> live;
+	// passes the callbacks can see through their PostPassGroup, which have to keep their own textures
+	std::unordered_set<const PostPass*> callbackPasses;
+	for (auto& [i, ref] : groupOutputs)
+		live.insert(ref.pass);
+	for (auto& draft : drafts)
+	{
+		PostPassGroup& group = passGroups[draft.group];
+		const bool callbacks = group.preDrawCallback || group.postDrawCallback;
+		// later groups can read any level of a mip chain through `p_group_chain`...
+		if (callbacks || chains.contains(draft.group))
+			for (auto& pass : group.passes)
+				live.insert(&pass);
+		if (callbacks)
+			for (auto& pass : group.passes)
+				callbackPasses.insert(&pass);
+	}
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		auto markRead = [&](const Ref& ref) { if (ref.pass && targets.contains(ref.pass) && live.insert(ref.pass).second) changed = true; };
+		for (auto& draft : drafts)
+		{
+			for (auto& blit : draft.blits)
+				if (live.contains(blit.dst))
+					markRead(blit.src);
+			for (auto& step : draft.steps)
+			{
+				if (!live.contains(step.target)) continue;
+				for (size_t unit = 0; unit < step.textures.size(); ++unit)
+					if (step.read[unit])
+						markRead(step.textures[unit]);
+			}
+		}
+	}
+
+	// a pass that is fully rewritten every frame before anything reads it doesn't need its own texture.
+	// those share textures with others of the same size and format whose contents are needed at different times
+	struct Lifetime { int firstWrite = INT_MAX; int lastWrite = -1; int lastRead = -1; bool transient = true; };
+	std::unordered_map<const PostPass*, Lifetime> lifetimes;
+	for (auto& draft : drafts)
+	{
+		PostPassGroup& group = passGroups[draft.group];
+		for (auto& blit : draft.blits)
+		{
+			if (!live.contains(blit.dst)) continue;
+			Lifetime& dst = lifetimes[blit.dst];
+			dst.firstWrite = glm::min(dst.firstWrite, blit.position);
+			dst.lastWrite = glm::max(dst.lastWrite, blit.position);
+			if (blit.src.pass)
+			{
+				Lifetime& src = lifetimes[blit.src.pass];
+				src.lastRead = glm::max(src.lastRead, blit.position);
+				if (src.firstWrite >= blit.position) src.transient = false;
+			}
+		}
+		for (auto& step : draft.steps)
+		{
+			if (!live.contains(step.target)) continue;
+			for (size_t unit = 0; unit < step.textures.size(); ++unit)
+			{
+				const PostPass* pass = step.textures[unit].pass;
+				if (!step.read[unit] || !pass) continue;
+				Lifetime& src = lifetimes[pass];
+				src.lastRead = glm::max(src.lastRead, step.position);
+				// read before it is written this frame, so last frame's contents are needed
+				if (src.firstWrite >= step.position) src.transient = false;
+			}
+			Lifetime& dst = lifetimes[step.target];
+			dst.firstWrite = glm::min(dst.firstWrite, step.position);
+			dst.lastWrite = glm::max(dst.lastWrite, step.position);
+			// drawing on top of what was there keeps it alive. compute passes write every texel themselves
+			if (!group.clearColor && !step.step.compute) dst.transient = false;
+		}
+	}
+
+	struct PoolEntry { int width, height, format; int freeAt; std::vector<const PostPass*> users; };
+	std::vector<PoolEntry> pool;
+	std::vector<std::pair<const PostPass*, Lifetime>> transients;
+	for (auto& [pass, lifetime] : lifetimes)
+	{
+		bool exposed = std::any_of(groupOutputs.begin(), groupOutputs.end(), [pass](const auto& output) { return output.second.pass == pass; });
+		if (lifetime.transient && !exposed && live.contains(pass) && targets.contains(pass) && !mipLevels.contains(pass) && !callbackPasses.contains(pass) && lifetime.firstWrite != INT_MAX)
+			transients.emplace_back(pass, lifetime);
+	}
+	std::sort(transients.begin(), transients.end(), [](const auto& a, const auto& b) { return a.second.firstWrite < b.second.firstWrite; });
+	for (auto& [pass, lifetime] : transients)
+	{
+		glm::ivec2 size = passSize(*pass);
+		auto entry = std::find_if(pool.begin(), pool.end(), [&](const PoolEntry& e)
+			{
+				return e.width == size.x && e.height == size.y && e.format == pass->getFormat() && e.freeAt < lifetime.firstWrite;
+			});
+		if (entry == pool.end())
+			entry = pool.insert(pool.end(), PoolEntry{ size.x, size.y, pass->getFormat(), -1 });
+		// a write after the last read still lands in the shared texture
+		entry->freeAt = glm::max(lifetime.lastRead, lifetime.lastWrite);
+		entry->users.emplace_back(pass);
+	}
+
+	// give every pass its texture: a shared one, its own, or none when it's culled
+	std::unordered_map<const PostPass*, uint32_t> aliased;
+	std::map<std::tuple<int, int, int>, uint32_t> slots;
+	for (auto& entry : pool)
+	{
+		// a texture nobody shares is better kept by its pass
+		if (entry.users.size() < 2) continue;
+		// transient contents don't outlive this framebuffer's render, so other framebuffers can use the same textures
+		uint32_t slot = slots[{ entry.width, entry.height, entry.format }]++;
+		uint32_t tex = RenderTargetPool::acquireShared(entry.width, entry.height, PostPass::getInternalFormat(entry.users.front()->getFormat()), slot);
+		plan.textures.emplace_back(tex);
+		for (const PostPass* pass : entry.users)
+			aliased[pass] = tex;
+	}
+	for (auto& group : passGroups)
+	{
+		for (auto& pass : group.passes)
+		{
+			if (!targets.contains(&pass)) continue;
+			if (!live.contains(&pass) || aliased.contains(&pass) || mipLevels.contains(&pass))
+			{
+				pass.cleanup();
+				continue;
+			}
+			glm::ivec2 size = passSize(pass);
+			if (pass.targetTex == 0 || pass.width != size.x || pass.height != size.y)
+				pass.initTexture(size.x, size.y);
+		}
+	}
+	auto resolve = [&](const Ref& ref) -> uint32_t
+		{
+			if (!ref.pass) return ref.tex;
+			if (auto mip = mipLevels.find(ref.pass); mip != mipLevels.end())
+				return chains[mip->second.first].views[mip->second.second];
+			auto it = aliased.find(ref.pass);
+			return it != aliased.end() ? it->second : ref.pass->targetTex;
+		};
+	// the texture and level a pass is drawn into
+	auto targetOf = [&](const PostPass* pass) -> std::pair<uint32_t, int>
+		{
+			if (auto mip = mipLevels.find(pass); mip != mipLevels.end())
+				return { chains[mip->second.first].tex, mip->second.second };
+			return { resolve({ pass }), 0 };
+		};
+
+	for (auto& draft : drafts)
+	{
+		PostPassGroup& group = passGroups[draft.group];
+		PlanGroup& planGroup = plan.groups.emplace_back();
+		planGroup.group = draft.group;
+		if (group.mipChain.mode == PostPassGroup::MipChain::GENERATE && chains.contains(draft.group))
+			planGroup.generateMips = chains[draft.group].tex;
+		if (draft.uniformBlock && !group.uniforms.empty())
+		{
+			planGroup.uniformSize = PostPassGroup::getUniformLayout(group.uniforms, planGroup.uniformOffsets);
+			glCreateBuffers(1, &planGroup.uniformBuffer);
+			glNamedBufferStorage(planGroup.uniformBuffer, planGroup.uniformSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+
+		group.outputTex = resolve(groupOutputs[draft.group]);
+		glNamedFramebufferTexture(group.targetFBO, GL_COLOR_ATTACHMENT0, group.outputTex, 0);
+
+		for (auto& blit : draft.blits)
+		{
+			if (!live.contains(blit.dst)) continue;
+			blit.blit.dstFBO = fboOf(targetOf(blit.dst));
+			blit.blit.srcFBO = blit.src.pass ? fboOf(targetOf(blit.src.pass)) : s->fbo;
+			if (blit.blit.srcFBO && blit.blit.dstFBO)
+				planGroup.blits.emplace_back(blit.blit);
+		}
+
+		for (auto& draftStep : draft.steps)
+		{
+			if (!live.contains(draftStep.target)) continue;
+
+			PlanStep& step = planGroup.steps.emplace_back(std::move(draftStep.step));
+			if (step.compute)
+				std::tie(step.image, step.imageLevel) = targetOf(draftStep.target);
+			else
+				step.fbo = fboOf(targetOf(draftStep.target));
+			// only what the shader samples gets bound
+			size_t units = glm::min(draftStep.textures.size(), (size_t)maxUnits);
+			while (units && !draftStep.read[units - 1])
+				--units;
+			step.textures.resize(units);
+			for (size_t unit = 0; unit < units; ++unit)
+				step.textures[unit] = draftStep.read[unit] ? resolve(draftStep.textures[unit]) : 0;
+			std::erase_if(step.userTextures, [&](const auto& user) { return user.first >= units || !draftStep.read[user.first]; });
+		}
+	}
+
+	plan.outputTex = resolve(outputID);
+	// until the upscale shader is ready, the scaled output is stretched by fbRenderer
+	if (scaled != glm::ivec2{ s->width, s->height } && plan.outputTex != s->colorTex && ShaderLoader::isReady(upscaleShader))
+	{
+		uint32_t tex = RenderTargetPool::acquire(s->width, s->height, GL_RGBA16F);
+		plan.textures.emplace_back(tex);
+		plan.upscale = { upscaleShader->id(), fboOf({ tex, 0 }), plan.outputTex };
+		plan.outputTex = tex;
+	}
+	plan.signature = planSignature(s);
+}
+
+static void setUniform(uint32_t program, int loc, const Uniform& uniform)
+{
+	switch (uniform.type)
+	{
+	case Uniform::FLOAT:
+		glProgramUniform1fv(program, loc, 1, (float*)uniform.value);
+		break;
+	case Uniform::VEC2:
+		glProgramUniform2fv(program, loc, 1, (float*)uniform.value);
+		break;
+	case Uniform::VEC3:
+		glProgramUniform3fv(program, loc, 1, (float*)uniform.value);
+		break;
+	case Uniform::VEC4:
+		glProgramUniform4fv(program, loc, 1, (float*)uniform.value);
+		break;
+	case Uniform::INT:
+		glProgramUniform1iv(program, loc, 1, (int*)uniform.value);
+		break;
+	case Uniform::IVEC2:
+		glProgramUniform2iv(program, loc, 1, (int*)uniform.value);
+		break;
+	case Uniform::IVEC3:
+		glProgramUniform3iv(program, loc, 1, (int*)uniform.value);
+		break;
+	case Uniform::IVEC4:
+		glProgramUniform4iv(program, loc, 1, (int*)uniform.value);
+		break;
+	case Uniform::UINT:
+		glProgramUniform1uiv(program, loc, 1, (uint32_t*)uniform.value);
+		break;
+	case Uniform::UVEC2:
+		glProgramUniform2uiv(program, loc, 1, (uint32_t*)uniform.value);
+		break;
+	case Uniform::UVEC3:
+		glProgramUniform3uiv(program, loc, 1, (uint32_t*)uniform.value);
+		break;
+	case Uniform::UVEC4:
+		glProgramUniform4uiv(program, loc, 1, (uint32_t*)uniform.value);
+		break;
+	}
+}
+
+// packs the group's uniforms and uploads them if anything changed since the last time
+static void uploadUniforms(PlanGroup& planGroup, const PostPassGroup& group)
+{
+	static std::vector<uint8_t> packed;
+	packed.assign(planGroup.uniformSize, 0);
+
+	for (size_t i = 0; i < group.uniforms.size() && i < planGroup.uniformOffsets.size(); ++i)
+	{
+		const Uniform& uniform = group.uniforms[i];
+		if (uniform.value)
+			memcpy(packed.data() + planGroup.uniformOffsets[i], uniform.value, uniform.getSize());
+	}
+
+	if (packed == planGroup.uniformData) return;
+
+	glNamedBufferSubData(planGroup.uniformBuffer, 0, packed.size(), packed.data());
+	planGroup.uniformData.swap(packed);
+}
+
+// moves the scale towards what fits the budget, going by the pixel count: the cost grows with the square of the scale
+static void updateScale(Scaling& scaling, float ms)
+{
+	const DynamicResolution& settings = scaling.settings;
+	scaling.gpuMs = scaling.samples ? glm::mix(scaling.gpuMs, ms, 0.1f) : ms;
+	// the first timings after a change can still be from the old scale
+	if (++scaling.samples < Scaling::FRAMES * 2) return;
+
+	float step = glm::max(settings.step, 0.01f);
+	float gpuMs = glm::max(scaling.gpuMs, 0.001f);
+	auto fit = [&](float budget) { return glm::clamp(glm::floor(scaling.scale * glm::sqrt(budget / gpuMs) / step) * step, settings.minScale, settings.maxScale); };
+
+	// going up needs some room left in the budget, or it'd flip between two steps
+	float down = fit(settings.budgetMs);
+	float up = fit(settings.budgetMs * 0.8f);
+	float scale = down < scaling.scale ? down : glm::max(up, scaling.scale);
+	if (scale == scaling.scale) return;
+
+	scaling.scale = scale;
+	scaling.samples = 0;
+}
+
+static void beginTiming(Scaling& scaling)
+{
+	if (!scaling.queries[0][0])
+		glCreateQueries(GL_TIMESTAMP, Scaling::FRAMES * 2, &scaling.queries[0][0]);
+
+	// the oldest timing is from FRAMES - 1 frames ago, and almost always done by now
+	int frame = scaling.frame;
+	if (scaling.pending[frame])
+	{
+		int available = 0;
+		glGetQueryObjectiv(scaling.queries[frame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			uint64_t begin = 0, end = 0;
+			glGetQueryObjectui64v(scaling.queries[frame][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(scaling.queries[frame][1], GL_QUERY_RESULT, &end);
+			updateScale(scaling, (end - begin) / 1000000.0f);
+		}
+		// a frame without a timing is skipped rather than waited for
+		scaling.pending[frame] = false;
+	}
+
+	glQueryCounter(scaling.queries[frame][0], GL_TIMESTAMP);
+}
+
+static void endTiming(Scaling& scaling)
+{
+	glQueryCounter(scaling.queries[scaling.frame][1], GL_TIMESTAMP);
+	scaling.pending[scaling.frame] = true;
+	scaling.frame = (scaling.frame + 1) % Scaling::FRAMES;
+}
+
+$hook(void, Framebuffer, render)
+{
+	FB* s = (FB*)self;
+	if (s->_magic_number != MAGIC_NUMBER)
+		return original(self);
+
+	// textures released while resizing are only freed once the size settles
+	RenderTargetPool::trim();
+
+	// before the groups, so their passes can sample it. game code ran since FXLib last bound anything
+	GLState::invalidate();
+	HiZ::build(*self, s->depthTex, s->width, s->height);
+
+	uint32_t outputID = s->colorTex;
+	auto& passGroups = *s->passGroups;
+	if (!passGroups.empty())
+	{
+		Plan& plan = plans[s];
+		if (plan.signature != planSignature(s))
+			buildPlan(s, plan);
+
+		Scaling* scaling = nullptr;
+		if (auto it = scalings.find(s); it != scalings.end() && it->second.settings.enabled)
+			scaling = &it->second;
+		if (scaling)
+			beginTiming(*scaling);
+
+		// the framebuffer 4D Miner is drawing into. it's bound by game code GLState can't see, so it's the one thing read back
+		int fb = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fb);
+		GLState::invalidate();
+
+		glDisable(GL_ALPHA_TEST);
+		GLState::bindVertexArray(passRenderer.VAO);
+		for (auto& planGroup : plan.groups)
+		{
+			PostPassGroup& group = passGroups[planGroup.group];
+
+			for (auto& blit : planGroup.blits)
+				glBlitNamedFramebuffer(blit.srcFBO, blit.dstFBO, 0, 0, blit.srcWidth, blit.srcHeight, 0, 0, blit.dstWidth, blit.dstHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 
 			if (group.blending.mode == PostPassGroup::Blending::DISABLED)
 			{
-				glDisable(GL_BLEND);
+				GLState::setBlendEnabled(false);
 			}
 			else
 			{
-				glEnable(GL_BLEND);
+				GLenum equation = GL_FUNC_ADD;
 				switch (group.blending.mode)
 				{
-				case PostPassGroup::Blending::ADD:
-					glBlendEquation(GL_FUNC_ADD);
-					break;
 				case PostPassGroup::Blending::SUBTRACT:
-					glBlendEquation(GL_FUNC_SUBTRACT);
+					equation = GL_FUNC_SUBTRACT;
 					break;
 				case PostPassGroup::Blending::REVERSE_SUBTRACT:
-					glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+					equation = GL_FUNC_REVERSE_SUBTRACT;
 					break;
 				case PostPassGroup::Blending::MIN:
-					glBlendEquation(GL_MIN);
+					equation = GL_MIN;
 					break;
 				case PostPassGroup::Blending::MAX:
-					glBlendEquation(GL_MAX);
+					equation = GL_MAX;
 					break;
 				}
-				glBlendFunc(group.blending.func.srcFactor, group.blending.func.dstFactor);
+				GLenum src = group.blending.func.srcFactor;
+				GLenum dst = group.blending.func.dstFactor;
+				GLState::setBlend({ true, equation, equation, src, dst, src, dst });
 			}
 
-			glBindFramebuffer(GL_FRAMEBUFFER, group.targetFBO);
+			if (planGroup.uniformBuffer)
+			{
+				uploadUniforms(planGroup, group);
+				GLState::bindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, planGroup.uniformBuffer);
+			}
+
+			GLState::bindFramebuffer(group.targetFBO);
 
 			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
 			if (group.preDrawCallback)
 			{
 				group.preDrawCallback(group);
+				GLState::invalidate();
+				GLState::bindVertexArray(passRenderer.VAO);
 			}
 
-			using enum PostPassGroup::PassIteration::Direction;
-
-			auto renderPass = [&](int ind, int prevInd, int nextInd)
+			for (auto& step : planGroup.steps)
+			{
+				if (!step.compute)
 				{
-					PostPass& prevPass = group.passes[prevInd];
-					PostPass& pass = group.passes[ind];
-					PostPass& nextPass = group.passes[nextInd];
-
-					int prevPassWidth = glm::max(s->width / prevPass.sizeDiv, 1);
-					int prevPassHeight = glm::max(s->height / prevPass.sizeDiv, 1);
-					int passWidth = glm::max(s->width / pass.sizeDiv, 1);
-					int passHeight = glm::max(s->height / pass.sizeDiv, 1);
-					int nextPassWidth = glm::max(s->width / nextPass.sizeDiv, 1);
-					int nextPassHeight = glm::max(s->height / nextPass.sizeDiv, 1);
-
-					switch (group.viewportMode)
-					{
-					case PostPassGroup::CURRENT_PASS_SIZE:
-						if (pass.targetTex == 0 || pass.width != passWidth || pass.height != passHeight)
-							pass.initTexture(passWidth, passHeight);
-
-						glViewport(0, 0, passWidth, passHeight);
-						glNamedFramebufferTexture(group.targetFBO, GL_COLOR_ATTACHMENT0, pass.targetTex, 0);
-						break;
-					case PostPassGroup::PREV_PASS_SIZE:
-						if (prevPass.targetTex == 0 || prevPass.width != prevPassWidth || prevPass.height != prevPassHeight)
-							prevPass.initTexture(prevPassWidth, prevPassHeight);
-
-						glViewport(0, 0, prevPassWidth, prevPassHeight);
-						glNamedFramebufferTexture(group.targetFBO, GL_COLOR_ATTACHMENT0, prevPass.targetTex, 0);
-						break;
-					case PostPassGroup::NEXT_PASS_SIZE:
-						if (nextPass.targetTex == 0 || nextPass.width != nextPassWidth || nextPass.height != nextPassHeight)
-							nextPass.initTexture(nextPassWidth, nextPassHeight);
-
-						glViewport(0, 0, nextPassWidth, nextPassHeight);
-						glNamedFramebufferTexture(group.targetFBO, GL_COLOR_ATTACHMENT0, nextPass.targetTex, 0);
-						break;
-					}
+					GLState::bindFramebuffer(step.fbo);
+					glViewport(0, 0, step.width, step.height);
 
 					if (group.clearColor)
 						glClear(GL_COLOR_BUFFER_BIT);
+				}
 
-					pass.shader->use();
-
-					glBindTextureUnit(0, s->colorTex);
-					glProgramUniform1i(pass.shader->id(), glGetUniformLocation(pass.shader->id(), "source"), 0);
-
-					glBindTextureUnit(1, s->depthTex);
-					glProgramUniform1i(pass.shader->id(), glGetUniformLocation(pass.shader->id(), "sourceDepth"), 1);
-
-					glBindTextureUnit(2, outputID);
-					glProgramUniform1i(pass.shader->id(), glGetUniformLocation(pass.shader->id(), "prevPassGroup"), 2);
-
-					glProgramUniform4f(pass.shader->id(), glGetUniformLocation(pass.shader->id(), "sourceSize"),
-						s->width, s->height, 1.0f / s->width, 1.0f / s->height);
-
-					int j = 0;
-					for (int l = 0; l < group.passes.size(); ++l)
-					{
-						const PostPass& otherPass = group.passes[l];
-						if (!otherPass.targetTex) continue;
-						glBindTextureUnit(j + 3, otherPass.targetTex);
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), std::format("pass{}", l).c_str());
-							if (loc != -1)
-								glProgramUniform1i(pass.shader->id(), loc, j + 3);
-						}
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), std::format("pass{}_size", l).c_str());
-							if (loc != -1)
-								glProgramUniform4f(pass.shader->id(), loc, otherPass.width, otherPass.height, 1.0f / otherPass.width, 1.0f / otherPass.height);
-						}
-						if (l == prevInd && ind != prevInd)
-						{
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "prevPass");
-								if (loc != -1)
-									glProgramUniform1i(pass.shader->id(), loc, j + 3);
-							}
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "prevPass_size");
-								if (loc != -1)
-									glProgramUniform4f(pass.shader->id(), loc, otherPass.width, otherPass.height, 1.0f / otherPass.width, 1.0f / otherPass.height);
-							}
-						}
-						if (l == ind)
-						{
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "curPass");
-								if (loc != -1)
-									glProgramUniform1i(pass.shader->id(), loc, j + 3);
-							}
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "curPass_size");
-								if (loc != -1)
-									glProgramUniform4f(pass.shader->id(), loc, pass.width, pass.height, 1.0f / pass.width, 1.0f / pass.height);
-							}
-						}
-						if (l == nextInd && ind != nextInd)
-						{
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "nextPass");
-								if (loc != -1)
-									glProgramUniform1i(pass.shader->id(), loc, j + 3);
-							}
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), "nextPass_size");
-								if (loc != -1)
-									glProgramUniform4f(pass.shader->id(), loc, nextPass.width, nextPass.height, 1.0f / nextPass.width, 1.0f / nextPass.height);
-							}
-						}
-						++j;
-					}
-					// fallback prevPass to outputID (prevPassGroup/default)
-					if (ind == prevInd)
-					{
-						glBindTextureUnit(j + 3, outputID);
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), "prevPass");
-							if (loc != -1)
-								glProgramUniform1i(pass.shader->id(), loc, j + 3);
-						}
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), "prevPass_size");
-							if (loc != -1)
-								glProgramUniform4f(pass.shader->id(), loc, s->width, s->height, 1.0f / s->width, 1.0f / s->height);
-						}
-						++j;
-					}
-
-					for (auto& tex : group.uniformTextures)
-					{
-						glBindTextureUnit(j + 3, tex.second);
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), tex.first.c_str());
-							if (loc != -1)
-								glProgramUniform1i(pass.shader->id(), loc, j + 3);
-						}
-						++j;
-					}
-
-					for (int k = 0; k < i; ++k)
-					{
-						const PostPassGroup& _group = passGroups[k];
-						int k_ = i - k;
-						std::string prefix = std::string(k_, 'p');
-						std::string name = std::format("{}_group", prefix);
-						glBindTextureUnit(j + 3, _group.outputTex);
-						{
-							int loc = glGetUniformLocation(pass.shader->id(), name.c_str());
-							glProgramUniform1i(pass.shader->id(), loc, j + 3);
-							++j;
-						}
-						int l = 0;
-						for (auto& p : _group.passes)
-						{
-							glBindTextureUnit(j + 3, p.targetTex);
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), std::format("{}_pass{}", name, l++).c_str());
-								if (loc != -1)
-									glProgramUniform1i(pass.shader->id(), loc, j + 3);
-							}
-							{
-								int loc = glGetUniformLocation(pass.shader->id(), std::format("{}_pass{}_size", name, l).c_str());
-								if (loc != -1)
-									glProgramUniform4f(pass.shader->id(), loc, p.width, p.height, 1.0f / p.width, 1.0f / p.height);
-							}
-							if (l == ind)
-							{
-								{
-									int loc = glGetUniformLocation(pass.shader->id(), std::format("{}_passInd", name).c_str());
-									if (loc != -1)
-										glProgramUniform1i(pass.shader->id(), loc, j + 3);
-								}
-								{
-									int loc = glGetUniformLocation(pass.shader->id(), std::format("{}_passInd_size", name).c_str());
-									if (loc != -1)
-										glProgramUniform4f(pass.shader->id(), loc, p.width, p.height, 1.0f / p.width, 1.0f / p.height);
-								}
-							}
-							++j;
-						}
-					}
-					{
-						{
-							std::string prefix = std::string(i + 1, 'p');
-							int loc = glGetUniformLocation(pass.shader->id(), std::format("{}_group", prefix).c_str());
-							if (loc != -1)
-								glProgramUniform1i(pass.shader->id(), loc, 0);
-							++j;
-						}
-					}
-
-					for (auto& uniform : group.uniforms)
-					{
-						int loc = glGetUniformLocation(pass.shader->id(), uniform.name.c_str());
-						if (loc == -1)
-							continue;
-
-						switch (uniform.type)
-						{
-						case Uniform::FLOAT:
-							glProgramUniform1fv(pass.shader->id(), loc, 1, (float*)uniform.value);
-							break;
-						case Uniform::VEC2:
-							glProgramUniform2fv(pass.shader->id(), loc, 1, (float*)uniform.value);
-							break;
-						case Uniform::VEC3:
-							glProgramUniform3fv(pass.shader->id(), loc, 1, (float*)uniform.value);
-							break;
-						case Uniform::VEC4:
-							glProgramUniform4fv(pass.shader->id(), loc, 1, (float*)uniform.value);
-							break;
-						case Uniform::INT:
-							glProgramUniform1iv(pass.shader->id(), loc, 1, (int*)uniform.value);
-							break;
-						case Uniform::IVEC2:
-							glProgramUniform2iv(pass.shader->id(), loc, 1, (int*)uniform.value);
-							break;
-						case Uniform::IVEC3:
-							glProgramUniform3iv(pass.shader->id(), loc, 1, (int*)uniform.value);
-							break;
-						case Uniform::IVEC4:
-							glProgramUniform4iv(pass.shader->id(), loc, 1, (int*)uniform.value);
-							break;
-						case Uniform::UINT:
-							glProgramUniform1uiv(pass.shader->id(), loc, 1, (uint32_t*)uniform.value);
-							break;
-						case Uniform::UVEC2:
-							glProgramUniform2uiv(pass.shader->id(), loc, 1, (uint32_t*)uniform.value);
-							break;
-						case Uniform::UVEC3:
-							glProgramUniform3uiv(pass.shader->id(), loc, 1, (uint32_t*)uniform.value);
-							break;
-						case Uniform::UVEC4:
-							glProgramUniform4uiv(pass.shader->id(), loc, 1, (uint32_t*)uniform.value);
-							break;
-						}
-					}
+				GLState::useProgram(step.program);
 
-					glBindVertexArray(passRenderer.VAO);
-					glDrawArrays(GL_TRIANGLES, 0, 6);
-				};
-
-			using enum PostPassGroup::PassIteration::Count;
-			int last = group.passes.size() - (group.iteration.count == SKIP_LAST ? 2 : 1);
-			int first = (group.iteration.count == SKIP_FIRST ? 1 : 0);
+				GLState::bindTextures(0, step.textures.size(), step.textures.data());
+				for (auto& [unit, tex] : step.userTextures)
+					GLState::bindTextureUnit(unit, *tex);
+				for (auto& [loc, unit] : step.samplers)
+					glProgramUniform1i(step.program, loc, unit);
+				for (auto& [loc, size] : step.sizes)
+					glProgramUniform4fv(step.program, loc, 1, &size[0]);
+				for (auto& [loc, uniform] : step.uniforms)
+					setUniform(step.program, loc, *uniform);
 
-			switch (group.iteration.dir)
-			{
-			case FORWARD:
-				for (int j = first; j <= last; ++j)
+				if (step.compute)
 				{
-					int prev = glm::clamp(j - 1, 0, (int)group.passes.size() - 1);
-					int next = glm::clamp(j + 1, 0, (int)group.passes.size() - 1);
-					renderPass(j, prev, next);
+					glBindImageTexture(0, step.image, step.imageLevel, GL_FALSE, 0, GL_WRITE_ONLY, step.imageFormat);
+					glDispatchCompute(step.groups.x, step.groups.y, 1);
+					// later passes sample it, blit it or draw on top of it
+					glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 				}
-				outputID = group.outputTex = group.passes[last].targetTex;
-				break;
-			case BACKWARD:
-				for (int j = last; j >= first; --j)
+				else
 				{
-					int prev = glm::clamp(j + 1, 0, (int)group.passes.size() - 1);
-					int next = glm::clamp(j - 1, 0, (int)group.passes.size() - 1);
-					renderPass(j, prev, next);
+					glDrawArrays(GL_TRIANGLES, 0, 6);
 				}
-				outputID = group.outputTex = group.passes[first].targetTex;
-				break;
 			}
 
+			if (planGroup.generateMips)
+				glGenerateTextureMipmap(planGroup.generateMips);
+
 			if (group.postDrawCallback)
 			{
 				group.postDrawCallback(group);
+				GLState::invalidate();
+				GLState::bindVertexArray(passRenderer.VAO);
 			}
 		}
+		if (plan.upscale.fbo)
+		{
+			GLState::setBlendEnabled(false);
+			GLState::bindFramebuffer(plan.upscale.fbo);
+			glViewport(0, 0, s->width, s->height);
+			GLState::useProgram(plan.upscale.program);
+			GLState::bindTextureUnit(0, plan.upscale.input);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+		outputID = plan.outputTex;
+
+		if (scaling)
+			endTiming(*scaling);
 
-		glEnable(GL_BLEND);
-		glBlendFuncSeparate(blendSrcRGB, blendDstRGB, blendSrcA, blendDstA);
-		glBlendEquationSeparate(blendEquationRGB, blendEquationA);
+		GLState::setBlend(GLState::defaultBlend);
 		glEnable(GL_ALPHA_TEST);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, fb);
+		GLState::bindFramebuffer(fb);
 	}
 
-	s->shader->use();
+	GLState::useProgram(s->shader->id());
 
-	glBindTextureUnit(0, outputID);
+	GLState::bindTextureUnit(0, outputID);
 	glProgramUniform1i(s->shader->id(), glGetUniformLocation(s->shader->id(), "texture"), 0);
 
-	glBindTextureUnit(1, s->depthTex);
+	GLState::bindTextureUnit(1, s->depthTex);
 	glProgramUniform1i(s->shader->id(), glGetUniformLocation(s->shader->id(), "depth"), 1);
 
 	fbRendererTex.ID = outputID;
@@ -530,6 +1179,37 @@ $hook(void, Framebuffer, render)
 	fbRendererTex.height = s->height;
 	fbRenderer.setPos(0, s->height, s->width, -s->height);
 	fbRenderer.render();
+	GLState::invalidate();
+}
+
+void FX::invalidatePostProcessing(fdm::Framebuffer& fb)
+{
+	auto it = plans.find((FB*)&fb);
+	if (it != plans.end())
+		it->second.signature = 0;
+}
+
+void FX::setFramebufferFormat(fdm::Framebuffer& fb, GLenum internalFormat)
+{
+	colorFormats[(FB*)&fb] = internalFormat;
+}
+
+void FX::setDynamicResolution(fdm::Framebuffer& fb, const DynamicResolution& settings)
+{
+	Scaling& scaling = scalings[(FB*)&fb];
+	scaling.settings = settings;
+	scaling.settings.maxScale = glm::clamp(settings.maxScale, 0.01f, 1.0f);
+	scaling.settings.minScale = glm::clamp(settings.minScale, 0.01f, scaling.settings.maxScale);
+	scaling.scale = settings.enabled ? scaling.settings.maxScale : 1.0f;
+	scaling.samples = 0;
+}
+
+float FX::getResolutionScale(fdm::Framebuffer& fb)
+{
+	auto it = scalings.find((FB*)&fb);
+	if (it == scalings.end() || !it->second.settings.enabled)
+		return 1.0f;
+	return it->second.scale;
 }
 
 void FX::applyPostProcessing(fdm::Framebuffer& fb, FramebufferInitCallback initCallback)
@@ -583,6 +1263,8 @@ $hookStatic(bool, ShaderManager, loadFromShaderList, const stl::string& jsonList
 			fbRenderer = TexRenderer{ &fbRendererTex, ShaderManager::get("postShader") };
 			fbRenderer.init();
 		}
+
+		upscaleShader = ShaderLoader::loadAsync("tr1ngledev.fxlib.upscale", "assets/shaders/pass.vert", "assets/shaders/upscale.frag");
 	}
 
 	return result;
@@ -0,0 +1,116 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/RenderTargetPool.h"
+
+using namespace FX;
+using namespace fdm;
+
+uint64_t RenderTargetPool::makeKey(int width, int height, GLenum internalFormat, int levels)
+{
+	return ((uint64_t)levels << 56) | ((uint64_t)width << 36) | ((uint64_t)height << 16) | (internalFormat & 0xFFFF);
+}
+
+uint32_t RenderTargetPool::create(int width, int height, GLenum internalFormat, int levels)
+{
+	bool depth = internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 ||
+		internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+
+	uint32_t tex = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+	glTextureStorage2D(tex, levels, internalFormat, width, height);
+	glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+	glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : (levels > 1 ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR));
+	glTextureParameteri(tex, GL_TEXTURE_WRAP_S, depth ? GL_CLAMP_TO_EDGE : GL_MIRRORED_REPEAT);
+	glTextureParameteri(tex, GL_TEXTURE_WRAP_T, depth ? GL_CLAMP_TO_EDGE : GL_MIRRORED_REPEAT);
+
+	return tex;
+}
+
+uint32_t RenderTargetPool::take(uint64_t key, int width, int height, GLenum internalFormat, int levels)
+{
+	uint32_t tex = 0;
+	auto it = freeTargets.find(key);
+	if (it != freeTargets.end() && !it->second.empty())
+	{
+		tex = it->second.back().tex;
+		it->second.pop_back();
+	}
+	else
+	{
+		tex = create(width, height, internalFormat, levels);
+	}
+
+	targets[tex] = Target{ key };
+	return tex;
+}
+
+uint32_t RenderTargetPool::acquire(int width, int height, GLenum internalFormat, int levels)
+{
+	return take(makeKey(width, height, internalFormat, levels), width, height, internalFormat, levels);
+}
+
+uint32_t RenderTargetPool::acquireShared(int width, int height, GLenum internalFormat, uint32_t slot)
+{
+	uint64_t key = makeKey(width, height, internalFormat, 1);
+
+	auto it = sharedTargets.find({ key, slot });
+	if (it != sharedTargets.end())
+	{
+		++targets[it->second].refs;
+		return it->second;
+	}
+
+	uint32_t tex = take(key, width, height, internalFormat, 1);
+	targets[tex].slot = slot;
+	sharedTargets[{ key, slot }] = tex;
+	return tex;
+}
+
+void RenderTargetPool::release(uint32_t tex)
+{
+	if (!tex) return;
+
+	auto it = targets.find(tex);
+	if (it == targets.end())
+	{
+		glDeleteTextures(1, &tex);
+		return;
+	}
+
+	Target& target = it->second;
+	if (--target.refs) return;
+
+	if (target.slot != UINT32_MAX)
+		sharedTargets.erase({ target.key, target.slot });
+	freeTargets[target.key].push_back({ tex, glfwGetTime() });
+	targets.erase(it);
+}
+
+void RenderTargetPool::trim(bool all)
+{
+	double now = glfwGetTime();
+	for (auto it = freeTargets.begin(); it != freeTargets.end();)
+	{
+		auto& list = it->second;
+		// oldest first
+		size_t expired = 0;
+		while (expired < list.size() && (all || now - list[expired].releaseTime > keepTime))
+		{
+			glDeleteTextures(1, &list[expired].tex);
+			++expired;
+		}
+		list.erase(list.begin(), list.begin() + expired);
+
+		if (list.empty())
+			it = freeTargets.erase(it);
+		else
+			++it;
+	}
+}
+
+size_t RenderTargetPool::getTextureCount()
+{
+	size_t count = targets.size();
+	for (auto& [key, list] : freeTargets)
+		count += list.size();
+	return count;
+}
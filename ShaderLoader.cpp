@@ -0,0 +1,339 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/ShaderLoader.h"
+
+#include <filesystem>
+
+using namespace FX;
+using namespace fdm;
+
+bool ShaderLoader::readFile(const std::string& path, std::string& source)
+{
+	std::ifstream file{ std::format("{}/{}", getModPath(modID), path), std::ios::binary };
+	if (!file.is_open())
+		return false;
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	source = stream.str();
+
+	return true;
+}
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+uint64_t ShaderLoader::getCacheKey(const Stages& stages)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	// a driver update invalidates the binaries
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* str = (const char*)glGetString(name);
+		if (str)
+			hash = hashBytes(hash, str, strlen(str));
+	}
+	for (auto& [type, source] : stages)
+	{
+		hash = hashBytes(hash, &type, sizeof(type));
+		hash = hashBytes(hash, source.data(), source.size());
+	}
+
+	return hash ? hash : 1;
+}
+
+std::string ShaderLoader::getCachePath(uint64_t key)
+{
+	return std::format("{}/shaderCache/{:016x}.bin", getModPath(modID), key);
+}
+
+uint32_t ShaderLoader::loadBinary(uint64_t key)
+{
+	std::ifstream file{ getCachePath(key), std::ios::binary };
+	if (!file.is_open())
+		return 0;
+
+	// the binary format, then the binary
+	GLenum format = 0;
+	file.read((char*)&format, sizeof(format));
+	std::vector<char> binary{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	if (binary.empty())
+		return 0;
+
+	uint32_t program = glCreateProgram();
+	glProgramBinary(program, format, binary.data(), binary.size());
+
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void ShaderLoader::storeBinary(uint32_t program, uint64_t key)
+{
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	GLenum format = 0;
+	std::vector<char> binary(length);
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0) return;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::format("{}/shaderCache", getModPath(modID)), error);
+
+	std::ofstream file{ getCachePath(key), std::ios::binary | std::ios::trunc };
+	if (!file.is_open()) return;
+
+	file.write((const char*)&format, sizeof(format));
+	file.write(binary.data(), length);
+}
+
+void ShaderLoader::init()
+{
+	if (initialized) return;
+	initialized = true;
+
+	// let the driver use as many compiler threads as it likes
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+}
+
+uint32_t ShaderLoader::queueProgram(const Stages& stages)
+{
+	init();
+
+	uint32_t program = glCreateProgram();
+	std::vector<uint32_t> shaderIDs;
+	for (auto& [type, source] : stages)
+	{
+		uint32_t shader = glCreateShader(type);
+		const char* src = source.c_str();
+		glShaderSource(shader, 1, &src, nullptr);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		shaderIDs.emplace_back(shader);
+	}
+	if (binaryCache)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	// linking right away without checking the stages keeps the driver from having to finish them here
+	glLinkProgram(program);
+
+	pending[program].stages = std::move(shaderIDs);
+
+	return program;
+}
+
+bool ShaderLoader::finishProgram(uint32_t program)
+{
+	Pending p = std::move(pending[program]);
+	pending.erase(program);
+
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char log[1024]{};
+		for (uint32_t shader : p.stages)
+		{
+			int compiled = 0;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if (compiled) continue;
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			logWarning(std::format("failed to compile a stage of \"{}\":\n{}", p.name, log));
+		}
+		glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+		logWarning(std::format("failed to link \"{}\":\n{}", p.name, log));
+		failed.insert(program);
+	}
+
+	for (uint32_t shader : p.stages)
+	{
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+	}
+
+	if (success && p.cacheKey)
+		storeBinary(program, p.cacheKey);
+
+	return success;
+}
+
+const FX::Shader* ShaderLoader::addShader(const std::string& name, uint32_t program)
+{
+	FX::Shader* shader = shaders[name] = new FX::Shader(program);
+	// list it with 4D Miner's shaders too so ShaderManager::get finds it, unless that name is taken there.
+	// FX::Shader has the same layout as fdm::Shader
+	if (!ShaderManager::shaders.contains(name))
+	{
+		ShaderManager::shaders[name] = (fdm::Shader*)shader;
+		managerShaders.insert(name);
+	}
+	return shader;
+}
+
+void ShaderLoader::removeShader(const std::string& name)
+{
+	if (managerShaders.contains(name))
+	{
+		ShaderManager::shaders.erase(name);
+		managerShaders.erase(name);
+	}
+	delete shaders[name];
+	shaders.erase(name);
+}
+
+const FX::Shader* ShaderLoader::loadCompute(const std::string& name, const std::string& computePath)
+{
+	if (shaders.contains(name))
+		return shaders[name];
+
+	std::string source;
+	if (!readFile(computePath, source))
+	{
+		logWarning(std::format("couldn't read \"{}\"", computePath));
+		return nullptr;
+	}
+
+	const FX::Shader* shader = loadFromSource(name, { { GL_COMPUTE_SHADER, source } });
+	if (!wait(shader))
+	{
+		glDeleteProgram(shader->id());
+		failed.erase(shader->id());
+		computePrograms.erase(shader->id());
+		removeShader(name);
+		return nullptr;
+	}
+
+	return shader;
+}
+
+const FX::Shader* ShaderLoader::loadFromSource(const std::string& name, const Stages& stages)
+{
+	if (shaders.contains(name))
+		return shaders[name];
+
+	const bool compute = std::any_of(stages.begin(), stages.end(), [](const auto& stage) { return stage.first == GL_COMPUTE_SHADER; });
+
+	uint64_t key = 0;
+	if (binaryCache)
+	{
+		key = getCacheKey(stages);
+		if (uint32_t program = loadBinary(key))
+		{
+			if (compute)
+				computePrograms.insert(program);
+			return addShader(name, program);
+		}
+	}
+
+	uint32_t program = queueProgram(stages);
+	if (compute)
+		computePrograms.insert(program);
+	pending[program].name = name;
+	pending[program].cacheKey = key;
+
+	return addShader(name, program);
+}
+
+const FX::Shader* ShaderLoader::loadAsync(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath)
+{
+	if (shaders.contains(name))
+		return shaders[name];
+
+	Stages stages{ { GL_VERTEX_SHADER, "" }, { GL_FRAGMENT_SHADER, "" } };
+	if (!geometryPath.empty())
+		stages.push_back({ GL_GEOMETRY_SHADER, "" });
+
+	const std::string* paths[]{ &vertexPath, &fragmentPath, &geometryPath };
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		if (!readFile(*paths[i], stages[i].second))
+		{
+			logWarning(std::format("couldn't read \"{}\"", *paths[i]));
+			return nullptr;
+		}
+	}
+
+	return loadFromSource(name, stages);
+}
+
+const FX::Shader* ShaderLoader::loadComputeAsync(const std::string& name, const std::string& computePath)
+{
+	if (shaders.contains(name))
+		return shaders[name];
+
+	std::string source;
+	if (!readFile(computePath, source))
+	{
+		logWarning(std::format("couldn't read \"{}\"", computePath));
+		return nullptr;
+	}
+
+	return loadFromSource(name, { { GL_COMPUTE_SHADER, source } });
+}
+
+bool ShaderLoader::isReady(const fdm::Shader* shader)
+{
+	if (!shader) return false;
+
+	uint32_t program = shader->id();
+	if (failed.contains(program)) return false;
+	if (!pending.contains(program)) return true;
+
+	if (parallelCompile)
+	{
+		int done = 0;
+		glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done) return false;
+	}
+
+	return finishProgram(program);
+}
+
+bool ShaderLoader::isCompute(const fdm::Shader* shader)
+{
+	return shader && computePrograms.contains(shader->id());
+}
+
+bool ShaderLoader::wait(const fdm::Shader* shader)
+{
+	if (!shader) return false;
+
+	uint32_t program = shader->id();
+	if (pending.contains(program))
+		return finishProgram(program);
+
+	return !failed.contains(program);
+}
+
+const FX::Shader* ShaderLoader::get(const std::string& name)
+{
+	auto it = shaders.find(name);
+	if (it == shaders.end())
+		return nullptr;
+	return it->second;
+}
@@ -95,6 +95,7 @@ void ShaderStorageBuffer::cleanup()
 {
 	if (ID)
 	{
+		GLState::forgetBuffer(ID);
 		glDeleteBuffers(1, &ID);
 		ID = NULL;
 		size = 0;
@@ -0,0 +1,134 @@
+#include "include/fxlib/FXLib.h"
+#include "include/fxlib/TrailBatch.h"
+
+using namespace FX;
+using namespace fdm;
+
+const FX::Shader* FX::TrailBatch::defaultShader = nullptr;
+
+TrailBatch::TrailBatch(const fdm::Shader* shader) : shader(shader)
+{
+}
+TrailBatch::~TrailBatch()
+{
+	if (VAO)
+	{
+		GLState::forgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+	}
+}
+void TrailBatch::add(const TrailRenderer& renderer, const Params& params)
+{
+	entries.push_back({ &renderer, params });
+}
+void TrailBatch::add(const TrailRenderer& renderer)
+{
+	add(renderer, Params{});
+}
+size_t TrailBatch::getQueuedCount() const
+{
+	return entries.size();
+}
+void TrailBatch::render(const m4::Mat5& view)
+{
+	using Vert = TrailRenderer::TrailMesh::Vert;
+
+	if (entries.empty()) return;
+	if (!ShaderLoader::isReady(shader))
+	{
+		entries.clear();
+		return;
+	}
+
+	commands.clear();
+	params.clear();
+
+	// lay every mesh out back to back. smoothed trails only exist on the GPU, so they get drawn on their own
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (auto& entry : entries)
+	{
+		uint32_t drawID = params.size();
+		params.emplace_back(entry.params);
+
+		if (entry.renderer->isSmoothing()) continue;
+
+		const auto& mesh = entry.renderer->getMesh();
+		if (mesh.indices.empty()) continue;
+
+		commands.push_back({ (uint32_t)mesh.indices.size(), 1, (uint32_t)indexCount, (int32_t)vertexCount, drawID });
+		vertexCount += mesh.vertices.size();
+		indexCount += mesh.indices.size();
+	}
+
+	if (drawIDs.size() < params.size())
+	{
+		size_t first = drawIDs.size();
+		drawIDs.resize(params.size());
+		for (size_t i = first; i < drawIDs.size(); ++i)
+			drawIDs[i] = i;
+		drawIDBuffer.uploadData(drawIDs.size() * sizeof(uint32_t), drawIDs.data());
+	}
+	paramBuffer.uploadData(params.size() * sizeof(Params), params.data());
+
+	if (!VAO)
+	{
+		glCreateVertexArrays(1, &VAO);
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			glEnableVertexArrayAttrib(VAO, i);
+			glVertexArrayAttribFormat(VAO, i, i == 5 ? 3 : 4, GL_FLOAT, GL_FALSE, i * sizeof(glm::vec4));
+			glVertexArrayAttribBinding(VAO, i, 0);
+		}
+		// `drawID` advances once per instance, so baseInstance selects it
+		glEnableVertexArrayAttrib(VAO, 6);
+		glVertexArrayAttribIFormat(VAO, 6, 1, GL_UNSIGNED_INT, 0);
+		glVertexArrayAttribBinding(VAO, 6, 1);
+		glVertexArrayBindingDivisor(VAO, 1, 1);
+	}
+
+	GLState::invalidate();
+	GLState::useProgram(shader->id());
+	((const FX::Shader*)shader)->setUniform("MV", view); // compat
+	((const FX::Shader*)shader)->setUniform("view", view);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, paramBuffer.id());
+
+	if (!commands.empty())
+	{
+		vertexBuffer.fit(vertexCount * sizeof(Vert));
+		indexBuffer.fit(indexCount * sizeof(uint32_t));
+		size_t vertexOffset = 0;
+		size_t indexOffset = 0;
+		for (auto& command : commands)
+		{
+			const auto& mesh = entries[command.baseInstance].renderer->getMesh();
+			glNamedBufferSubData(vertexBuffer.id(), vertexOffset * sizeof(Vert), mesh.vertices.size() * sizeof(Vert), mesh.vertices.data());
+			glNamedBufferSubData(indexBuffer.id(), indexOffset * sizeof(uint32_t), mesh.indices.size() * sizeof(uint32_t), mesh.indices.data());
+			vertexOffset += mesh.vertices.size();
+			indexOffset += mesh.indices.size();
+		}
+		commandBuffer.uploadData(commands.size() * sizeof(Command), commands.data());
+
+		// the buffers get recreated when they grow
+		glVertexArrayVertexBuffer(VAO, 0, vertexBuffer.id(), 0, sizeof(Vert));
+		glVertexArrayVertexBuffer(VAO, 1, drawIDBuffer.id(), 0, sizeof(uint32_t));
+		glVertexArrayElementBuffer(VAO, indexBuffer.id());
+
+		GLState::bindVertexArray(VAO);
+		GLState::bindDrawIndirectBuffer(commandBuffer.id());
+		glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, commands.size(), 0);
+		// 4D Miner binds element buffers without a VAO of its own, which would replace the batch's
+		GLState::bindVertexArray(0);
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!entries[i].renderer->isSmoothing()) continue;
+
+		// their VAO has no `drawID` array, so the current attribute value is used
+		glVertexAttribI1ui(6, i);
+		entries[i].renderer->render();
+	}
+
+	entries.clear();
+}
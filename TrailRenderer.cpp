@@ -1,21 +1,195 @@
 #include "include/fxlib/FXLib.h"
 #include "include/fxlib/TrailRenderer.h"
+#include "include/fxlib/Simd.h"
 
 using namespace FX;
 using namespace fdm;
 
 const FX::Shader* FX::TrailRenderer::defaultShader = nullptr;
+const FX::Shader* FX::TrailRenderer::smoothShader = nullptr;
+
+// tetrahedra (as lines_adjacency) of the caps and of the segment between two rings of vertices.
+// shared with trail_smooth.comp, which gets them through a buffer.
+//
+// the vertices of a segment are numbered by which side of each axis they are on:
+// bit 0 = -over, bit 1 = -up, bit 2 = front (tesseractal only), next bit = the next point's ring
+namespace
+{
+	using Cube = std::array<uint32_t, 8>;
+	using CubeTets = std::array<uint32_t, 5 * 4>;
+
+	constexpr bool evenParity(uint32_t v)
+	{
+		bool even = true;
+		for (; v; v >>= 1)
+			even ^= v & 1;
+		return even;
+	}
+
+	// the 8 corners of the cube where `fixedAxis` is on `side`, indexed by the bits of the 3 remaining axes
+	constexpr Cube cubeCorners(uint32_t axes, uint32_t fixedAxis, uint32_t side)
+	{
+		Cube corners{};
+		for (uint32_t local = 0; local < 8; ++local)
+		{
+			uint32_t v = side << fixedAxis;
+			for (uint32_t axis = 0, bit = 0; axis < axes; ++axis)
+			{
+				if (axis == fixedAxis) continue;
+				v |= ((local >> bit++) & 1) << axis;
+			}
+			corners[local] = v;
+		}
+		return corners;
+	}
+
+	// the minimal split of a cube: the tetrahedron between its 4 even corners plus one per odd corner.
+	// the parity is the one of the vertex number plus the index of the vertex's ring in the trail, so cubes sharing a face
+	// split it along the same diagonal, also across segments. a segment starting at an odd ring flips it (`oddRing`)
+	constexpr CubeTets cubeTetrahedra(const Cube& c, bool oddRing)
+	{
+		CubeTets out{};
+		size_t n = 0;
+		for (uint32_t local = 0; local < 8; ++local)
+			if (evenParity(c[local]) != oddRing)
+				out[n++] = c[local];
+		for (uint32_t local = 0; local < 8; ++local)
+		{
+			if (evenParity(c[local]) != oddRing) continue;
+			out[n++] = c[local];
+			out[n++] = c[local ^ 1];
+			out[n++] = c[local ^ 2];
+			out[n++] = c[local ^ 4];
+		}
+		return out;
+	}
+
+	// 6 times the volume of a tetrahedron in the cube's local 0/1 coordinates
+	constexpr int tetVolume6(const Cube& c, const uint32_t* tet)
+	{
+		int m[3][3]{};
+		uint32_t l[4]{};
+		for (int i = 0; i < 4; ++i)
+			for (uint32_t local = 0; local < 8; ++local)
+				if (c[local] == tet[i]) l[i] = local;
+		for (int i = 0; i < 3; ++i)
+			for (int axis = 0; axis < 3; ++axis)
+				m[i][axis] = (int)((l[i + 1] >> axis) & 1) - (int)((l[0] >> axis) & 1);
+		int det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+			- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+			+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		return det < 0 ? -det : det;
+	}
+
+	// every tetrahedron is non-degenerate and together they have the volume of the cube (6 in these units).
+	// every face inside the cube is shared by exactly 2 tetrahedra, every face on its surface belongs to 1
+	constexpr bool coversCube(const Cube& c, const CubeTets& tets)
+	{
+		int volume = 0;
+		for (size_t t = 0; t < tets.size(); t += 4)
+		{
+			int v = tetVolume6(c, &tets[t]);
+			if (v == 0) return false;
+			volume += v;
+		}
+		if (volume != 6) return false;
+
+		for (size_t t = 0; t < tets.size(); t += 4)
+		{
+			for (int skip = 0; skip < 4; ++skip)
+			{
+				uint32_t face[3]{};
+				for (int i = 0, j = 0; i < 4; ++i)
+					if (i != skip) face[j++] = tets[t + i];
+
+				int uses = 0;
+				for (size_t u = 0; u < tets.size(); u += 4)
+				{
+					int shared = 0;
+					for (int i = 0; i < 4; ++i)
+						shared += tets[u + i] == face[0] || tets[u + i] == face[1] || tets[u + i] == face[2];
+					uses += shared == 3;
+				}
+
+				// on the surface when all 3 corners are on the same side of one of the axes
+				uint32_t ones = 0b111, zeros = 0b111;
+				for (uint32_t f : face)
+					for (uint32_t local = 0; local < 8; ++local)
+						if (c[local] == f)
+						{
+							ones &= local;
+							zeros &= ~local;
+						}
+				bool onSurface = (ones | zeros) & 0b111;
+
+				if (uses != (onSurface ? 1 : 2)) return false;
+			}
+		}
+		return true;
+	}
+
+	// the split for segments starting at an even ring, followed by the one for segments starting at an odd ring
+	template<size_t Cubes>
+	constexpr std::array<uint32_t, Cubes * 5 * 4 * 2> prismSides(uint32_t axes, const std::array<std::pair<uint32_t, uint32_t>, Cubes>& sides)
+	{
+		std::array<uint32_t, Cubes * 5 * 4 * 2> out{};
+		size_t n = 0;
+		for (bool oddRing : { false, true })
+			for (auto [axis, side] : sides)
+				for (uint32_t index : cubeTetrahedra(cubeCorners(axes, axis, side), oddRing))
+					out[n++] = index;
+		return out;
+	}
+
+	template<size_t Cubes>
+	constexpr bool coversPrismSides(uint32_t axes, const std::array<std::pair<uint32_t, uint32_t>, Cubes>& sides)
+	{
+		for (bool oddRing : { false, true })
+			for (auto [axis, side] : sides)
+			{
+				Cube c = cubeCorners(axes, axis, side);
+				if (!coversCube(c, cubeTetrahedra(c, oddRing))) return false;
+			}
+		return true;
+	}
+
+	// flat trails are a 3D volume: one cube per segment (axis 3 doesn't exist there, so nothing is fixed).
+	// their caps are flat squares, which never show up in the slice
+	constexpr std::array<std::pair<uint32_t, uint32_t>, 1> flatSegmentCubes{ { { 3, 0 } } };
+	// tesseractal trails only need their surface: the 6 cubes around the segment, and the point's own cube as a cap
+	constexpr std::array<std::pair<uint32_t, uint32_t>, 6> tesseractSegmentCubes{ { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 2, 0 }, { 2, 1 } } };
+	constexpr std::array<std::pair<uint32_t, uint32_t>, 1> tesseractCapCubes{ { { 3, 0 } } };
+
+	static_assert(coversPrismSides(3, flatSegmentCubes));
+	static_assert(coversPrismSides(4, tesseractSegmentCubes));
+	static_assert(coversPrismSides(4, tesseractCapCubes));
+}
+
+static constexpr std::array<uint32_t, 0> flatCapPattern{ };
+static constexpr auto flatSegmentPattern = prismSides(3, flatSegmentCubes);
+static constexpr auto tesseractCapPattern = prismSides(4, tesseractCapCubes);
+static constexpr auto tesseractSegmentPattern = prismSides(4, tesseractSegmentCubes);
+
+// the half of a pattern for a segment or cap starting at the `ring`th ring of its trail
+static std::span<const uint32_t> patternFor(std::span<const uint32_t> pattern, size_t ring)
+{
+	const size_t half = pattern.size() / 2;
+	return pattern.subspan((ring & 1) * half, half);
+}
 
 TrailRenderer::TrailRenderer(size_t maxPointsPerTrail, size_t trails)
 {
 	this->maxPointsPerTrail = maxPointsPerTrail;
-
-	this->trails.reserve(trails);
-	for (size_t i = 0; i < trails; i++)
-		this->trails.emplace_back(maxPointsPerTrail);
-
-	mesh.indices.reserve(maxPointsPerTrail * trails * 20 + 8);
-	mesh.vertices.reserve(maxPointsPerTrail * trails * 4);
+	this->trails.resize(trails);
+}
+TrailRenderer::~TrailRenderer()
+{
+	releaseMemory(memoryUsage.load());
+	if (smoothVAO)
+	{
+		GLState::forgetVertexArray(smoothVAO);
+		glDeleteVertexArrays(1, &smoothVAO);
+	}
 }
 void TrailRenderer::initRenderer()
 {
@@ -27,7 +201,22 @@ void TrailRenderer::setMode(GLenum mode)
 }
 void TrailRenderer::render() const
 {
-	renderer.render();
+	if (!smoothing)
+	{
+		renderer.render();
+		// fdm::MeshRenderer binds behind GLState's back
+		GLState::invalidate();
+		return;
+	}
+
+	if (!smoothVAO) return;
+
+	GLState::invalidate();
+	GLState::bindVertexArray(smoothVAO);
+	GLState::bindDrawIndirectBuffer(commandBuffer.id());
+	glDrawElementsIndirect(renderer.mode, GL_UNSIGNED_INT, nullptr);
+	// 4D Miner binds element buffers without a VAO of its own, which would replace smoothVAO's
+	GLState::bindVertexArray(0);
 }
 void TrailRenderer::update()
 {
@@ -35,7 +224,9 @@ void TrailRenderer::update()
 
 	for (auto& trail : trails)
 	{
-		for (int j = 0; j < trail.points.size();)
+		size_t expiredTail = 0;
+		bool expiredInside = false;
+		for (size_t j = 0; j < trail.points.size();)
 		{
 			TrailPoint& p = trail.points[j];
 
@@ -43,6 +234,12 @@ void TrailRenderer::update()
 
 			if (t >= 1.01f)
 			{
+				// points expiring from the tail leave the cached frames of the rest intact
+				if (j == 0)
+					++expiredTail;
+				else
+					expiredInside = true;
+
 				trail.points.erase(trail.points.begin() + j);
 			}
 			else
@@ -50,22 +247,194 @@ void TrailRenderer::update()
 				++j;
 			}
 		}
+
+		if (expiredTail || expiredInside)
+			trail.boundsDirty = true;
+		if (expiredTail && trail.isDirty())
+			trail.dirtyFrom = trail.dirtyFrom > expiredTail ? trail.dirtyFrom - expiredTail : 0;
+		if (expiredInside)
+		{
+			trail.invalidate(0);
+			trail.decimated.clear();
+		}
+	}
+}
+void TrailRenderer::updateFrames(Trail& trail)
+{
+	const size_t last = trail.points.size() - 1;
+	if (trail.points.size() < 2 || trail.dirtyFrom > last)
+	{
+		trail.dirtyFrom = Trail::CLEAN;
+		return;
+	}
+
+	if (trail.dirtyFrom < last)
+	{
+		TrailPoint* p = trail.points.data() + trail.dirtyFrom;
+		simd::pointFrames(&p->pos, &p->normal, &p->tangent, sizeof(TrailPoint), last - trail.dirtyFrom,
+			&p->dir, &p->forward, &p->up, &p->diagA, &p->diagB);
+	}
+
+	// the last point faces away from the one before it, and follows the trail's own frame while the trail drags it
+	TrailPoint& a = trail.points[last];
+	a.dir = -glm::normalize(trail.points[last - 1].pos - a.pos);
+	if (a.createdByTrail)
+	{
+		a.forward = glm::normalize(trail.normal);
+		a.up = glm::normalize(trail.tangent);
+	}
+	else
+	{
+		a.forward = glm::normalize(a.normal);
+		a.up = glm::normalize(a.tangent);
 	}
+	glm::vec4 over = glm::normalize(m4::cross(a.dir, a.forward, a.up));
+
+	a.diagA = a.up + over;
+	a.diagB = a.up - over;
+
+	trail.dirtyFrom = Trail::CLEAN;
+}
+void TrailRenderer::updateBounds(Trail& trail)
+{
+	if (trail.points.empty()) return;
+
+	trail.boundsMin = trail.boundsMax = trail.points.front().pos;
+	for (auto& point : trail.points)
+	{
+		trail.boundsMin = glm::min(trail.boundsMin, point.pos);
+		trail.boundsMax = glm::max(trail.boundsMax, point.pos);
+	}
+	if (trail.points.back().createdByTrail)
+	{
+		trail.boundsMin = glm::min(trail.boundsMin, trail.pos);
+		trail.boundsMax = glm::max(trail.boundsMax, trail.pos);
+	}
+
+	trail.boundsDirty = false;
+}
+bool TrailRenderer::isVisible(const Trail& trail, const m4::Mat5& view, const HiZ::Readback* occlusion) const
+{
+	glm::vec4 center = (trail.boundsMin + trail.boundsMax) * 0.5f;
+	glm::vec4 extent = (trail.boundsMax - trail.boundsMin) * 0.5f + cullMargin;
+
+	// the box in view space, as a center and an extent along each axis
+	auto project = [&](int row, float& c, float& e) {
+		c = view[4][row];
+		e = 0.f;
+		for (int col = 0; col < 4; ++col)
+		{
+			c += view[col][row] * center[col];
+			e += glm::abs(view[col][row]) * extent[col];
+		}
+	};
+
+	float z, zExtent, w, wExtent;
+	project(2, z, zExtent);
+	project(3, w, wExtent);
+
+	// the camera looks down -z, and only w = 0 is rendered
+	if (glm::abs(w) > wExtent || z - zExtent >= 0.f) return false;
+	if (!occlusion) return true;
+
+	float x, xExtent, y, yExtent;
+	project(0, x, xExtent);
+	project(1, y, yExtent);
+	return !occlusion->isHidden({ x, y, z }, glm::length(glm::vec3{ xExtent, yExtent, zExtent }));
+}
+void TrailRenderer::evalAttributes(const float* t, const float* p, const size_t* trailIDs, size_t count, float* widths, glm::vec4* colors) const
+{
+	if (widthBatchFunc)
+		widthBatchFunc(t, p, trailIDs, count, widths, user);
+	else if (widthFunc)
+		for (size_t i = 0; i < count; ++i)
+			widths[i] = widthFunc(t[i], p[i], trailIDs[i], user);
+	else
+		for (size_t i = 0; i < count; ++i)
+			widths[i] = widthCurve.eval(t[i], p[i]);
+
+	if (colorBatchFunc)
+		colorBatchFunc(t, p, trailIDs, count, colors, user);
+	else if (colorFunc)
+		for (size_t i = 0; i < count; ++i)
+			colors[i] = colorFunc(t[i], p[i], trailIDs[i], user);
+	else
+		for (size_t i = 0; i < count; ++i)
+			colors[i] = colorCurve.eval(t[i], p[i]);
 }
 void TrailRenderer::updateMesh(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver)
 {
-	mesh.vertices.clear();
-	mesh.indices.clear();
+	buildMesh(camLeft, camUp, camForward, camOver);
+	swapMesh();
+	uploadMesh();
+}
+void TrailRenderer::updateMesh(const m4::Mat5& view)
+{
+	buildMesh(view);
+	swapMesh();
+	uploadMesh();
+}
+void TrailRenderer::buildMesh(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver)
+{
+	meshTrails(camLeft, camUp, camForward, camOver, nullptr);
+}
+void TrailRenderer::buildMesh(const m4::Mat5& view)
+{
+	meshTrails(
+		glm::vec4(view[0][0], view[1][0], view[2][0], view[3][0]),
+		glm::vec4(view[0][1], view[1][1], view[2][1], view[3][1]),
+		glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]),
+		glm::vec4(view[0][3], view[1][3], view[2][3], view[3][3]),
+		&view);
+}
+void TrailRenderer::meshTrails(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver, const m4::Mat5* view)
+{
+	built.vertices.clear();
+	built.indices.clear();
+	built.segments.clear();
+	built.ready = true;
+	built.tesseractal = tesseractal;
 
-	if (trails.empty()) return;
+	// the segments can only be subdivided by their projected length when the view is known
+	const bool smoothed = built.smoothing = smooth && smoothReady && view && renderer.VAO;
+	if (view)
+		built.view = *view;
 
-	constexpr size_t numThreads = 4;
-	size_t trailsPerThread = trails.size() / numThreads;
-	size_t remainingTrails = trails.size() % numThreads;
+	if (trails.empty()) return;
 
-	auto processTrails = [&](size_t start, size_t end, std::vector<TrailRenderer::TrailMesh::Vert>& vertices, std::vector<uint32_t>& indices) {
-		size_t v = 0;
-		glm::vec4 left, up, over, forward;
+	const bool cull = culling && view;
+	// kept alive for the jobs, HiZ may publish a newer one meanwhile
+	std::shared_ptr<const HiZ::Readback> occlusion = cull && occlusionCulling ? HiZ::getReadback() : nullptr;
+
+	// one job per thread, so every job's output can be merged in order afterwards
+	const size_t jobCount = glm::min(trails.size(), JobSystem::get().threadCount());
+	const size_t trailsPerJob = trails.size() / jobCount;
+	const size_t remainingTrails = trails.size() % jobCount;
+
+	const uint32_t ringSize = !tesseractal ? 4 : 8;
+	const std::span<const uint32_t> capPattern = !tesseractal ? std::span<const uint32_t>(flatCapPattern) : tesseractCapPattern;
+	const std::span<const uint32_t> segmentPattern = !tesseractal ? std::span<const uint32_t>(flatSegmentPattern) : tesseractSegmentPattern;
+
+	auto processTrails = [&](size_t start, size_t end, std::vector<TrailRenderer::TrailMesh::Vert>& vertices, std::vector<uint32_t>& indices, std::vector<Segment>& segments) {
+		uint32_t v = 0;
+
+		float curTime = glfwGetTime();
+
+		// gather the inputs of every point first, so width and color are evaluated in one batch per job
+		thread_local std::vector<float> ts, ps, widths;
+		thread_local std::vector<size_t> ids;
+		thread_local std::vector<glm::vec4> colors;
+		// per point inputs of the frame and vertex kernels
+		thread_local std::vector<glm::vec4> centers, dirs, forwards, ups, diagAs, diagBs, corners;
+		ts.clear();
+		ps.clear();
+		ids.clear();
+		centers.clear();
+		dirs.clear();
+		forwards.clear();
+		ups.clear();
+		diagAs.clear();
+		diagBs.clear();
 
 		for (size_t id = start; id < end; ++id)
 		{
@@ -73,386 +442,374 @@ void TrailRenderer::updateMesh(const glm::vec4& camLeft, const glm::vec4& camUp,
 
 			if (trail.points.size() < 2) continue;
 
-			float curTime = glfwGetTime();
+			if (cull)
+			{
+				if (trail.boundsDirty)
+					updateBounds(trail);
+				trail.visible = isVisible(trail, *view, occlusion.get());
+				if (!trail.visible) continue;
+			}
+			else
+			{
+				trail.visible = true;
+			}
+
+			// the basis of a point only depends on data fixed at insertion, so it is only rebuilt for changed trails
+			if (trail.isDirty())
+				updateFrames(trail);
 
+			const size_t last = trail.points.size() - 1;
 			for (size_t i = 0; i < trail.points.size(); ++i)
 			{
-				size_t nextI = i + 1;
-				if (nextI >= trail.points.size())
-					nextI = i - 1;
-
-				TrailPoint& a = trail.points[i];
-				TrailPoint& b = trail.points[nextI];
+				const TrailPoint& a = trail.points[i];
 
 				float t = (curTime - a.createTime) / lifetime;
-				t = glm::clamp(t, 0.0f, 1.0f);
 				float p = (float)i / ((float)trail.points.size() - 1);
-				p = glm::clamp(p, 0.0f, 1.0f);
-
-				float widthHalf = widthFunc(t, p, id, user) * 0.5f;
-				glm::vec4 color = colorFunc(t, p, id, user);
+				ts.emplace_back(glm::clamp(t, 0.0f, 1.0f));
+				ps.emplace_back(glm::clamp(p, 0.0f, 1.0f));
+				ids.emplace_back(id);
 
-				glm::vec4 dir = glm::normalize(b.pos - a.pos);
-				if (nextI == i - 1)
-					dir *= -1;
-
-				left = dir;
-				if (a.createdByTrail && i == trail.points.size() - 1)
+				centers.emplace_back(a.createdByTrail && i == last ? trail.pos : a.pos);
+				dirs.emplace_back(a.dir);
+				if (!billboard)
 				{
-					forward = glm::normalize(trail.normal);
-					up = glm::normalize(trail.tangent);
+					forwards.emplace_back(a.forward);
+					ups.emplace_back(a.up);
+					diagAs.emplace_back(a.diagA);
+					diagBs.emplace_back(a.diagB);
 				}
-				else
-				{
-					forward = glm::normalize(a.normal);
-					up = glm::normalize(a.tangent);
-				}
-				over = glm::normalize(m4::cross(left, forward, up));
+			}
+		}
 
-				if (billboard)
-				{
-					up = glm::normalize(m4::cross(left, camForward, camOver));
-					forward = glm::normalize(m4::cross(left, up, camOver));
-					over = glm::normalize(m4::cross(left, forward, up));
-				}
+		widths.resize(ts.size());
+		colors.resize(ts.size());
+		evalAttributes(ts.data(), ps.data(), ids.data(), ts.size(), widths.data(), colors.data());
 
-				glm::vec4 pos = a.pos;
-				if (a.createdByTrail && i == trail.points.size() - 1)
-				{
-					pos = trail.pos;
-				}
+		const size_t count = ts.size();
+		for (size_t k = 0; k < count; ++k)
+			widths[k] *= 0.5f;
 
-				if (!tesseractal)
-				{
-					vertices.emplace_back(pos + up * widthHalf + over * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 1 });
-					vertices.emplace_back(pos + up * widthHalf - over * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 0 });
-					vertices.emplace_back(pos - up * widthHalf + over * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 1 });
-					vertices.emplace_back(pos - up * widthHalf - over * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 0 });
-				}
-				else
-				{
-					vertices.emplace_back(pos + up * widthHalf + over * widthHalf - forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 1 });
-					vertices.emplace_back(pos + up * widthHalf - over * widthHalf - forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 0 });
-					vertices.emplace_back(pos - up * widthHalf + over * widthHalf - forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 1 });
-					vertices.emplace_back(pos - up * widthHalf - over * widthHalf - forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 0 });
-
-					vertices.emplace_back(pos + up * widthHalf + over * widthHalf + forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 1 });
-					vertices.emplace_back(pos + up * widthHalf - over * widthHalf + forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 1, 0 });
-					vertices.emplace_back(pos - up * widthHalf + over * widthHalf + forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 1 });
-					vertices.emplace_back(pos - up * widthHalf - over * widthHalf + forward * widthHalf, forward, up, dir, color, glm::vec3{ p, 0, 0 });
-				}
+		if (billboard)
+		{
+			forwards.resize(count);
+			ups.resize(count);
+			diagAs.resize(count);
+			diagBs.resize(count);
+			simd::billboardFrames(dirs.data(), count, camForward, camOver, forwards.data(), ups.data(), diagAs.data(), diagBs.data());
+		}
 
-				if (i == 0 || i == trail.points.size() - 1)
+		corners.resize(count * ringSize);
+		if (!tesseractal)
+		{
+			simd::ringCorners(centers.data(), diagAs.data(), diagBs.data(), widths.data(), count, corners.data(), 4);
+		}
+		else
+		{
+			// the back ring, then the front one
+			thread_local std::vector<glm::vec4> shifted;
+			shifted.resize(count);
+			for (size_t k = 0; k < count; ++k)
+				shifted[k] = centers[k] - forwards[k] * widths[k];
+			simd::ringCorners(shifted.data(), diagAs.data(), diagBs.data(), widths.data(), count, corners.data(), 8);
+			for (size_t k = 0; k < count; ++k)
+				shifted[k] = centers[k] + forwards[k] * widths[k];
+			simd::ringCorners(shifted.data(), diagAs.data(), diagBs.data(), widths.data(), count, corners.data() + 4, 8);
+		}
+
+		// every ring repeats the same uv corners: +diagA, +diagB, -diagB, -diagA
+		static const glm::vec2 cornerUVs[4]{ { 1, 1 }, { 1, 0 }, { 0, 1 }, { 0, 0 } };
+		vertices.resize(count * ringSize);
+		for (size_t k = 0; k < count; ++k)
+		{
+			for (uint32_t c = 0; c < ringSize; ++c)
+			{
+				TrailMesh::Vert& vert = vertices[k * ringSize + c];
+				vert.pos = corners[k * ringSize + c];
+				vert.normal = forwards[k];
+				vert.tangent = ups[k];
+				vert.biTangent = dirs[k];
+				vert.color = colors[k];
+				vert.uvw = glm::vec3{ ps[k], cornerUVs[c & 3].x, cornerUVs[c & 3].y };
+			}
+		}
+
+		for (size_t id = start; id < end; ++id)
+		{
+			const Trail& trail = trails[id];
+
+			if (trail.points.size() < 2 || !trail.visible) continue;
+
+			const size_t last = trail.points.size() - 1;
+
+			for (size_t i = 0; i < trail.points.size(); ++i)
+			{
+				if (smoothed)
 				{
-					if (!tesseractal)
-					{
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 1);
-						indices.emplace_back(v + 2);
-						indices.emplace_back(v + 3);
-					}
-					else
+					// the compute pass builds the tetrahedra itself, it only needs to know which rings form a segment
+					if (i != last)
 					{
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 1);
-
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 7);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 2);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 4);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
+						uint32_t ring = v / ringSize;
+						segments.push_back({
+							{ i != 0 ? ring - 1 : ring, ring, ring + 1, i + 1 != last ? ring + 2 : ring + 1 },
+							(i == 0 ? Segment::FIRST : 0u) | (i + 1 == last ? Segment::LAST : 0u) });
 					}
 				}
-
-				if (i != trail.points.size() - 1)
+				else
 				{
-					if (!tesseractal)
-					{
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 1);
-
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 7);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 2);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 6);
-						indices.emplace_back(v + 4);
-
-						indices.emplace_back(v + 0);
-						indices.emplace_back(v + 5);
-						indices.emplace_back(v + 3);
-						indices.emplace_back(v + 6);
-					}
-					else
-					{
-						// side -x
-						{
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 1);
-
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 7);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 2);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 4);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 6);
-						}
+					if (i == 0 || i == last)
+						for (uint32_t index : patternFor(capPattern, i))
+							indices.emplace_back(v + index);
 
-						// side +z
-						{
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 1);
-
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 11);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 2);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 8);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 3);
-							indices.emplace_back(v + 10);
-						}
+					if (i != last)
+						for (uint32_t index : patternFor(segmentPattern, i))
+							indices.emplace_back(v + index);
+				}
 
-						// side -z
-						{
-							indices.emplace_back(v + 4);
-							indices.emplace_back(v + 7);
-							indices.emplace_back(v + 13);
-							indices.emplace_back(v + 5);
-
-							indices.emplace_back(v + 13);
-							indices.emplace_back(v + 7);
-							indices.emplace_back(v + 14);
-							indices.emplace_back(v + 15);
-
-							indices.emplace_back(v + 4);
-							indices.emplace_back(v + 7);
-							indices.emplace_back(v + 14);
-							indices.emplace_back(v + 6);
-
-							indices.emplace_back(v + 4);
-							indices.emplace_back(v + 13);
-							indices.emplace_back(v + 14);
-							indices.emplace_back(v + 12);
-
-							indices.emplace_back(v + 4);
-							indices.emplace_back(v + 13);
-							indices.emplace_back(v + 7);
-							indices.emplace_back(v + 14);
-						}
+				v += ringSize;
+			}
+		}
+		};
 
-						// side +y
-						{
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 1);
-
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 13);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 4);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 8);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 9);
-							indices.emplace_back(v + 5);
-							indices.emplace_back(v + 12);
-						}
+	std::vector<std::vector<TrailRenderer::TrailMesh::Vert>> vertices(jobCount);
+	std::vector<std::vector<uint32_t>> indices(jobCount);
+	std::vector<std::vector<Segment>> threadSegments(jobCount);
 
-						// side -y
-						{
-							indices.emplace_back(v + 0 + 2);
-							indices.emplace_back(v + 5 + 2);
-							indices.emplace_back(v + 9 + 2);
-							indices.emplace_back(v + 1 + 2);
-
-							indices.emplace_back(v + 9 + 2);
-							indices.emplace_back(v + 5 + 2);
-							indices.emplace_back(v + 12 + 2);
-							indices.emplace_back(v + 13 + 2);
-
-							indices.emplace_back(v + 0 + 2);
-							indices.emplace_back(v + 5 + 2);
-							indices.emplace_back(v + 12 + 2);
-							indices.emplace_back(v + 4 + 2);
-
-							indices.emplace_back(v + 0 + 2);
-							indices.emplace_back(v + 9 + 2);
-							indices.emplace_back(v + 12 + 2);
-							indices.emplace_back(v + 8 + 2);
-
-							indices.emplace_back(v + 0 + 2);
-							indices.emplace_back(v + 9 + 2);
-							indices.emplace_back(v + 5 + 2);
-							indices.emplace_back(v + 12 + 2);
-						}
+	JobSystem::get().parallelFor(0, jobCount, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i)
+		{
+			size_t start = i * trailsPerJob + glm::min(i, remainingTrails);
+			size_t end = start + trailsPerJob + (i < remainingTrails ? 1 : 0);
+			processTrails(start, end, vertices[i], indices[i], threadSegments[i]);
+		}
+	}, 1);
 
-						// side +w
-						{
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 8);
-
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 11);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 2);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 6);
-							indices.emplace_back(v + 4);
-
-							indices.emplace_back(v + 0);
-							indices.emplace_back(v + 12);
-							indices.emplace_back(v + 10);
-							indices.emplace_back(v + 6);
-						}
+	for (size_t i = 0; i < jobCount; ++i)
+	{
+		for (auto& i : indices[i])
+		{
+			i += built.vertices.size();
+		}
+		uint32_t ringOffset = built.vertices.size() / ringSize;
+		for (auto& segment : threadSegments[i])
+		{
+			for (auto& ring : segment.rings)
+				ring += ringOffset;
+		}
+		built.vertices.insert(built.vertices.end(), vertices[i].begin(), vertices[i].end());
+		built.indices.insert(built.indices.end(), indices[i].begin(), indices[i].end());
+		built.segments.insert(built.segments.end(), threadSegments[i].begin(), threadSegments[i].end());
+	}
+}
+bool TrailRenderer::swapMesh()
+{
+	if (!built.ready) return false;
+	built.ready = false;
 
-						// side -w
-						{
-							indices.emplace_back(v + 0 + 1);
-							indices.emplace_back(v + 10 + 1);
-							indices.emplace_back(v + 12 + 1);
-							indices.emplace_back(v + 8 + 1);
-
-							indices.emplace_back(v + 12 + 1);
-							indices.emplace_back(v + 10 + 1);
-							indices.emplace_back(v + 6 + 1);
-							indices.emplace_back(v + 11 + 1);
-
-							indices.emplace_back(v + 0 + 1);
-							indices.emplace_back(v + 10 + 1);
-							indices.emplace_back(v + 6 + 1);
-							indices.emplace_back(v + 2 + 1);
-
-							indices.emplace_back(v + 0 + 1);
-							indices.emplace_back(v + 12 + 1);
-							indices.emplace_back(v + 6 + 1);
-							indices.emplace_back(v + 4 + 1);
-
-							indices.emplace_back(v + 0 + 1);
-							indices.emplace_back(v + 12 + 1);
-							indices.emplace_back(v + 10 + 1);
-							indices.emplace_back(v + 6 + 1);
-						}
-					}
-				}
+	std::swap(mesh.vertices, built.vertices);
+	std::swap(mesh.indices, built.indices);
+	std::swap(segments, built.segments);
+	smoothing = built.smoothing;
+	meshView = built.view;
+	meshTesseractal = built.tesseractal;
+	meshDirty = true;
 
-				v += !tesseractal ? 4 : 8;
-			}
-		}
-		};
+	return true;
+}
+void TrailRenderer::uploadMesh()
+{
+	if (!smoothReady)
+		smoothReady = ShaderLoader::isReady(smoothShader);
 
-	std::vector<std::vector<TrailRenderer::TrailMesh::Vert>> vertices(numThreads);
-	std::vector<std::vector<uint32_t>> indices(numThreads);
-	std::vector<std::future<void>> futures;
-	futures.reserve(numThreads);
+	if (!meshDirty) return;
+	meshDirty = false;
 
-	size_t start = 0;
-	for (size_t i = 0; i < numThreads; ++i)
+	if (smoothing)
+	{
+		if (!meshTesseractal)
+			smoothMesh(meshView, 4, flatCapPattern, flatSegmentPattern);
+		else
+			smoothMesh(meshView, 8, tesseractCapPattern, tesseractSegmentPattern);
+	}
+	else if (renderer.VAO && !batched)
 	{
-		size_t end = start + trailsPerThread + (i < remainingTrails ? 1 : 0);
-		futures.emplace_back(threadPool.enqueue(processTrails, start, end, std::ref(vertices[i]), std::ref(indices[i])));
-		start = end;
+		renderer.updateMesh(&mesh);
+		GLState::invalidate();
 	}
+}
+void TrailRenderer::smoothMesh(const m4::Mat5& view, uint32_t ringSize, std::span<const uint32_t> capPattern, std::span<const uint32_t> segmentPattern)
+{
+	using Vert = TrailMesh::Vert;
 
-	for (auto& future : futures)
+	uint32_t levels = glm::max(maxSubdivisions, 1u);
+	size_t caps = 0;
+	for (auto& segment : segments)
 	{
-		future.get();
+		if (segment.flags & Segment::FIRST) ++caps;
+		if (segment.flags & Segment::LAST) ++caps;
 	}
 
-	for (size_t i = 0; i < numThreads; ++i)
+	// DrawElementsIndirectCommand followed by the vertex counter of the compute pass
+	constexpr uint32_t command[6]{ 0, 1, 0, 0, 0, 0 };
+	commandBuffer.uploadData(sizeof(command), command);
+
+	if (segments.empty()) return;
+
+	std::vector<uint32_t> pattern{ segmentPattern.begin(), segmentPattern.end() };
+	pattern.insert(pattern.end(), capPattern.begin(), capPattern.end());
+
+	controlBuffer.uploadData(mesh.vertices.size() * sizeof(Vert), mesh.vertices.data());
+	segmentBuffer.uploadData(segments.size() * sizeof(Segment), segments.data());
+	patternBuffer.uploadData(pattern.size() * sizeof(uint32_t), pattern.data());
+	smoothVertices.fit(segments.size() * (levels + 1) * ringSize * sizeof(Vert));
+	smoothIndices.fit((segments.size() * levels * segmentPattern.size() + caps * capPattern.size()) / 2 * sizeof(uint32_t));
+
+	controlBuffer.use(1);
+	segmentBuffer.use(2);
+	patternBuffer.use(3);
+	smoothVertices.use(4);
+	smoothIndices.use(5);
+	commandBuffer.use(6);
+
+	smoothShader->use();
+	smoothShader->setUniform("view", view);
+	smoothShader->setUniform("segmentCount", (uint32_t)segments.size());
+	smoothShader->setUniform("ringSize", ringSize);
+	smoothShader->setUniform("segmentIndexCount", (uint32_t)segmentPattern.size() / 2);
+	smoothShader->setUniform("capIndexCount", (uint32_t)capPattern.size() / 2);
+	smoothShader->setUniform("maxSubdivisions", levels);
+	smoothShader->setUniform("subdivisionDensity", subdivisionDensity);
+
+	glDispatchCompute((segments.size() + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	if (!smoothVAO)
 	{
-		for (auto& i : indices[i])
+		glCreateVertexArrays(1, &smoothVAO);
+		for (uint32_t i = 0; i < 6; ++i)
 		{
-			i += mesh.vertices.size();
+			glEnableVertexArrayAttrib(smoothVAO, i);
+			glVertexArrayAttribFormat(smoothVAO, i, i == 5 ? 3 : 4, GL_FLOAT, GL_FALSE, i * sizeof(glm::vec4));
+			glVertexArrayAttribBinding(smoothVAO, i, 0);
 		}
-		mesh.vertices.insert(mesh.vertices.end(), vertices[i].begin(), vertices[i].end());
-		mesh.indices.insert(mesh.indices.end(), indices[i].begin(), indices[i].end());
 	}
+	// the buffers get recreated when they grow
+	glVertexArrayVertexBuffer(smoothVAO, 0, smoothVertices.id(), 0, sizeof(Vert));
+	glVertexArrayElementBuffer(smoothVAO, smoothIndices.id());
+}
+static float segmentDistance(const glm::vec4& p, const glm::vec4& a, const glm::vec4& b)
+{
+	glm::vec4 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = len2 > 0.f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f) : 0.f;
+	return glm::length(p - (a + ab * t));
+}
+bool TrailRenderer::claimMemory(size_t bytes)
+{
+	// trails of one renderer may grow from several jobs at once
+	size_t used = memoryUsage.load(std::memory_order_relaxed);
+	do
+	{
+		if (memoryBudget && used + bytes > memoryBudget) return false;
+	} while (!memoryUsage.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
 
-	if (renderer.VAO)
-		renderer.updateMesh(&mesh);
+	size_t global = globalMemoryUsage.fetch_add(bytes) + bytes;
+	if (globalMemoryBudget && global > globalMemoryBudget)
+	{
+		globalMemoryUsage -= bytes;
+		memoryUsage -= bytes;
+		return false;
+	}
+
+	return true;
+}
+void TrailRenderer::releaseMemory(size_t bytes)
+{
+	memoryUsage -= bytes;
+	globalMemoryUsage -= bytes;
+}
+bool TrailRenderer::growPoints(Trail& trail)
+{
+	size_t capacity = trail.points.capacity();
+	if (trail.points.size() < capacity) return true;
+
+	// grow geometrically, but settle for a single point when the budget is tight
+	size_t wanted = glm::min(glm::max(capacity * 2, (size_t)8), maxPointsPerTrail);
+	for (size_t newCapacity : { wanted, capacity + 1 })
+	{
+		if (!claimMemory((newCapacity - capacity) * sizeof(TrailPoint))) continue;
+
+		trail.points.reserve(newCapacity);
+		// in case the vector rounds up
+		size_t extra = (trail.points.capacity() - newCapacity) * sizeof(TrailPoint);
+		memoryUsage += extra;
+		globalMemoryUsage += extra;
+		return true;
+	}
+	return false;
+}
+void TrailRenderer::freePoints(Trail& trail)
+{
+	releaseMemory(trail.points.capacity() * sizeof(TrailPoint));
+	std::vector<TrailPoint>().swap(trail.points);
+	trail.decimated.clear();
+	trail.dirtyFrom = Trail::CLEAN;
+	trail.boundsDirty = true;
+}
+void TrailRenderer::recountMemory()
+{
+	size_t bytes = 0;
+	for (auto& trail : trails)
+		bytes += trail.points.capacity() * sizeof(TrailPoint);
+
+	globalMemoryUsage += bytes;
+	globalMemoryUsage -= memoryUsage.exchange(bytes);
 }
 bool TrailRenderer::addPoint(const glm::vec4& pos, const glm::vec4& normal, const glm::vec4& tangent, size_t trailID, float timeOffset)
 {
 	if (trailID >= trails.size()) return false;
 	Trail& trail = trails[trailID];
 
-	if (trail.points.size() == trail.points.capacity()) return false;
+	// merge into the previous point while the polyline stays within the tolerance
+	if (decimationTolerance > 0.f && trail.points.size() >= 2 && trail.decimated.size() < Trail::MAX_DECIMATED)
+	{
+		const glm::vec4& anchor = trail.points[trail.points.size() - 2].pos;
+		const glm::vec4& candidate = trail.points.back().pos;
+
+		bool straight = segmentDistance(candidate, anchor, pos) <= decimationTolerance;
+		for (size_t i = 0; straight && i < trail.decimated.size(); ++i)
+			straight = segmentDistance(trail.decimated[i], anchor, pos) <= decimationTolerance;
+
+		if (straight)
+		{
+			trail.decimated.emplace_back(candidate);
+			trail.points.pop_back();
+		}
+		else
+		{
+			trail.decimated.clear();
+		}
+	}
+	else
+	{
+		trail.decimated.clear();
+	}
+
+	if (trail.points.size() >= maxPointsPerTrail) return false;
+
+	if (!growPoints(trail))
+	{
+		// out of budget: keep the trail moving by recycling its oldest point
+		if (trail.points.size() < 2) return false;
+
+		trail.points.erase(trail.points.begin());
+		if (trail.isDirty())
+			trail.dirtyFrom = trail.dirtyFrom ? trail.dirtyFrom - 1 : 0;
+		trail.boundsDirty = true;
+	}
 
 	trail.points.emplace_back(pos, normal, tangent, (float)glfwGetTime() + timeOffset);
+	trail.expandBounds(pos);
+	trail.invalidate(trail.points.size() >= 2 ? trail.points.size() - 2 : 0);
 
 	return true;
 }
@@ -484,13 +841,16 @@ void TrailRenderer::setMaxPoints(size_t maxPoints)
 	maxPointsPerTrail = maxPoints;
 	for (auto& trail : trails)
 	{
-		trail.points.reserve(maxPoints);
-
 		if (trail.points.size() > maxPoints)
+		{
 			trail.points.resize(maxPoints);
+			trail.boundsDirty = true;
+			trail.invalidate(maxPoints ? maxPoints - 1 : 0);
+		}
+		if (trail.points.capacity() > maxPoints)
+			trail.points.shrink_to_fit();
 	}
-	mesh.indices.reserve(maxPointsPerTrail * trails.size() * 20 + 8);
-	mesh.vertices.reserve(maxPointsPerTrail * trails.size() * 4);
+	recountMemory();
 }
 size_t TrailRenderer::getMaxPoints() const
 {
@@ -498,16 +858,9 @@ size_t TrailRenderer::getMaxPoints() const
 }
 void TrailRenderer::setTrailsCount(size_t trails)
 {
-	this->trails.reserve(trails);
-	if (this->trails.size() < trails)
-	{
-		for (size_t i = 0; i < trails - this->trails.size(); i++)
-			this->trails.emplace_back(maxPointsPerTrail);
-	}
-	if (this->trails.size() > trails)
-	{
-		this->trails.resize(trails);
-	}
+	for (size_t i = trails; i < this->trails.size(); ++i)
+		freePoints(this->trails[i]);
+	this->trails.resize(trails);
 }
 size_t TrailRenderer::getTrailsCount() const
 {
@@ -521,17 +874,31 @@ size_t TrailRenderer::getIndexCount() const
 {
 	return mesh.indices.size();
 }
+size_t TrailRenderer::getMemoryUsage() const
+{
+	return memoryUsage;
+}
+size_t TrailRenderer::getGlobalMemoryUsage()
+{
+	return globalMemoryUsage;
+}
 void TrailRenderer::clearPoints(size_t trailID)
 {
 	if (trailID >= trails.size()) return;
 	Trail& trail = trails[trailID];
 	trail.points.clear();
+	trail.decimated.clear();
+	trail.dirtyFrom = Trail::CLEAN;
+	trail.boundsDirty = true;
 }
 void TrailRenderer::clearPoints()
 {
 	for (auto& trail : trails)
 	{
 		trail.points.clear();
+		trail.decimated.clear();
+		trail.dirtyFrom = Trail::CLEAN;
+		trail.boundsDirty = true;
 	}
 }
 
@@ -583,6 +950,10 @@ TrailRenderer& TrailRenderer::operator=(const TrailRenderer& other)
 	this->lifetime = other.lifetime;
 	this->widthFunc = other.widthFunc;
 	this->colorFunc = other.colorFunc;
+	this->widthBatchFunc = other.widthBatchFunc;
+	this->colorBatchFunc = other.colorBatchFunc;
+	this->widthCurve = other.widthCurve;
+	this->colorCurve = other.colorCurve;
 	this->user = other.user;
 	this->billboard = other.billboard;
 	this->tesseractal = other.tesseractal;
@@ -590,6 +961,15 @@ TrailRenderer& TrailRenderer::operator=(const TrailRenderer& other)
 	this->mesh.vertices = other.mesh.vertices;
 	this->mesh.indices = other.mesh.indices;
 	this->maxPointsPerTrail = other.maxPointsPerTrail;
+	this->decimationTolerance = other.decimationTolerance;
+	this->culling = other.culling;
+	this->cullMargin = other.cullMargin;
+	this->occlusionCulling = other.occlusionCulling;
+	this->memoryBudget = other.memoryBudget;
+	this->smooth = other.smooth;
+	this->batched = other.batched;
+	this->subdivisionDensity = other.subdivisionDensity;
+	this->maxSubdivisions = other.maxSubdivisions;
 	setMaxPoints(maxPointsPerTrail);
 
 	return *this;
@@ -600,6 +980,10 @@ TrailRenderer& TrailRenderer::operator=(TrailRenderer&& other) noexcept
 	this->lifetime = other.lifetime;
 	this->widthFunc = other.widthFunc;
 	this->colorFunc = other.colorFunc;
+	this->widthBatchFunc = other.widthBatchFunc;
+	this->colorBatchFunc = other.colorBatchFunc;
+	this->widthCurve = other.widthCurve;
+	this->colorCurve = other.colorCurve;
 	this->user = other.user;
 	this->billboard = other.billboard;
 	this->tesseractal = other.tesseractal;
@@ -608,19 +992,40 @@ TrailRenderer& TrailRenderer::operator=(TrailRenderer&& other) noexcept
 	this->mesh.indices = other.mesh.indices;
 	this->maxPointsPerTrail = other.maxPointsPerTrail;
 	this->minTrailPointDist = other.minTrailPointDist;
+	this->decimationTolerance = other.decimationTolerance;
+	this->culling = other.culling;
+	this->cullMargin = other.cullMargin;
+	this->occlusionCulling = other.occlusionCulling;
+	this->memoryBudget = other.memoryBudget;
+	this->smooth = other.smooth;
+	this->batched = other.batched;
+	this->subdivisionDensity = other.subdivisionDensity;
+	this->maxSubdivisions = other.maxSubdivisions;
 	setMaxPoints(maxPointsPerTrail);
 
 	other.lifetime = 1.f;
-	other.widthFunc = defaultWidth;
-	other.colorFunc = defaultColor;
+	other.widthFunc = nullptr;
+	other.colorFunc = nullptr;
+	other.widthBatchFunc = nullptr;
+	other.colorBatchFunc = nullptr;
+	other.widthCurve = {};
+	other.colorCurve = { Curve<glm::vec4>::POSITION, glm::vec4{ 1.f, 1.f, 1.f, 0.f }, glm::vec4{ 1.f } };
 	other.user = nullptr;
 	other.billboard = false;
 	other.tesseractal = false;
 	other.trails.clear();
+	other.recountMemory();
 	other.mesh.vertices.clear();
 	other.mesh.indices.clear();
 	other.maxPointsPerTrail = 0;
 	other.minTrailPointDist = 0.2f;
+	other.decimationTolerance = 0.f;
+	other.culling = false;
+	other.cullMargin = 1.f;
+	other.occlusionCulling = false;
+	other.memoryBudget = 0;
+	other.smooth = false;
+	other.batched = false;
 
 	return *this;
 }
@@ -634,9 +1039,15 @@ void TrailRenderer::setTrailPos(size_t trailID, const glm::vec4& pos, const glm:
 	glm::vec4 diff = pos - lastPos;
 	if (trail.points.empty() || glm::abs(glm::dot(diff, diff)) >= minTrailPointDist * minTrailPointDist)
 	{
-		addPoint(pos, glm::normalize(normal), glm::normalize(tangent), trailID);
-		trail.points.back().createdByTrail = true;
+		// the point is dropped when the trail is full or out of budget
+		if (addPoint(pos, glm::normalize(normal), glm::normalize(tangent), trailID))
+			trail.points.back().createdByTrail = true;
 	}
+	// the head point follows the trail's orientation, so only its frame goes stale here
+	if (!trail.points.empty() && trail.points.back().createdByTrail && (trail.normal != normal || trail.tangent != tangent))
+		trail.invalidate(trail.points.size() - 1);
+	if (!trail.points.empty() && trail.points.back().createdByTrail)
+		trail.expandBounds(pos);
 	trail.pos = pos;
 	trail.normal = normal;
 	trail.tangent = tangent;
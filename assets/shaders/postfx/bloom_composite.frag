@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+// the image the bloom was made from. FXLib defines it as `ppp_group` unless the bloom is the first group
+#ifndef SCENE
+#define SCENE source
+#endif
+uniform sampler2D SCENE;
+uniform sampler2D p_group; // the upsample chain's last level
+uniform float intensity;
+
+void main()
+{
+	color = texture(SCENE, uv);
+	color.rgb += texture(p_group, uv).rgb * intensity;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D prevPass; // the previous group's output, or the source for the first group
+uniform vec4 prevPass_size;
+uniform vec4 curPass_size;
+
+// box filter of the input texels under the output texel. every bilinear tap sits between 2x2 of them,
+// so a sizeDiv of 2 is 1 fetch and one of 4 is 4
+void main()
+{
+	ivec2 taps = max(ivec2(prevPass_size.xy * curPass_size.zw * 0.5 + 0.5), ivec2(1));
+	vec2 first = uv - curPass_size.zw * 0.5 + prevPass_size.zw;
+	vec4 sum = vec4(0.0);
+	for (int y = 0; y < taps.y; ++y)
+		for (int x = 0; x < taps.x; ++x)
+			sum += texture(prevPass, first + vec2(x, y) * prevPass_size.zw * 2.0);
+	color = sum / float(taps.x * taps.y);
+}
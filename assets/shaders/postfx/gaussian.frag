@@ -0,0 +1,25 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D prevPass; // the horizontal pass, or for it the downsampled input (the previous group's output at sizeDiv 1)
+uniform vec4 curPass_size;
+
+// the kernel is precomputed by FXLib: TAPS bilinear taps per side with their OFFSETS in texels and WEIGHTS,
+// each tap falling between 2 texels so it reads both with one fetch. DIRECTION is vec2(1, 0) or vec2(0, 1)
+const float offsets[TAPS] = OFFSETS;
+const float weights[TAPS] = WEIGHTS;
+
+void main()
+{
+	vec2 texel = curPass_size.zw * DIRECTION;
+	vec4 sum = texture(prevPass, uv) * weights[0];
+	for (int i = 1; i < TAPS; ++i)
+	{
+		sum += texture(prevPass, uv + texel * offsets[i]) * weights[i];
+		sum += texture(prevPass, uv - texel * offsets[i]) * weights[i];
+	}
+	color = sum;
+}
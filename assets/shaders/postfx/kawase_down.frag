@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D prevPass; // the level above, or the previous group's output for the first pass
+uniform vec4 prevPass_size;
+uniform float offset;
+
+// dual kawase downsample: the center and 4 diagonal bilinear taps, 5 fetches
+void main()
+{
+	vec2 o = prevPass_size.zw * offset;
+	vec4 sum = texture(prevPass, uv) * 4.0;
+	sum += texture(prevPass, uv + vec2(-o.x, -o.y));
+	sum += texture(prevPass, uv + vec2( o.x, -o.y));
+	sum += texture(prevPass, uv + vec2(-o.x,  o.y));
+	sum += texture(prevPass, uv + vec2( o.x,  o.y));
+	color = sum / 8.0;
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D prevPass; // the level below, or the downsample chain's last level for the first pass
+uniform vec4 prevPass_size;
+uniform float offset;
+#ifdef BLOOM
+uniform sampler2D p_group_chain; // the downsample chain
+uniform vec4 curPass_size;
+#endif
+
+// dual kawase upsample: 4 taps on the axes and 4 diagonal ones weighted twice, 8 fetches
+void main()
+{
+	vec2 o = prevPass_size.zw * 0.5 * offset;
+	vec4 sum = texture(prevPass, uv + vec2(-o.x * 2.0, 0.0));
+	sum += texture(prevPass, uv + vec2( o.x * 2.0, 0.0));
+	sum += texture(prevPass, uv + vec2(0.0, -o.y * 2.0));
+	sum += texture(prevPass, uv + vec2(0.0,  o.y * 2.0));
+	sum += texture(prevPass, uv + vec2(-o.x, -o.y)) * 2.0;
+	sum += texture(prevPass, uv + vec2( o.x, -o.y)) * 2.0;
+	sum += texture(prevPass, uv + vec2(-o.x,  o.y)) * 2.0;
+	sum += texture(prevPass, uv + vec2( o.x,  o.y)) * 2.0;
+	color = sum / 12.0;
+#ifdef BLOOM
+	// plus the downsampled level of the same size, so every level contributes.
+	// the chain can be smaller than the source with dynamic resolution, so the level comes from its own size
+	color += textureLod(p_group_chain, uv, round(log2(float(textureSize(p_group_chain, 0).x) * curPass_size.z)));
+#endif
+}
@@ -0,0 +1,45 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D prevPass; // the previous group's output, or the source for the first group
+uniform vec4 prevPass_size;
+uniform float threshold;
+uniform float knee;
+
+float brightness(vec3 c)
+{
+	return max(c.r, max(c.g, c.b));
+}
+
+// 0 below threshold - knee, a quadratic curve up to threshold + knee, then linear
+vec3 prefilter(vec3 c)
+{
+	float b = brightness(c);
+	float soft = clamp(b - threshold + knee, 0.0, 2.0 * knee);
+	soft = soft * soft / (4.0 * knee + 0.00001);
+	return c * (max(soft, b - threshold) / max(b, 0.00001));
+}
+
+void main()
+{
+#ifdef DOWNSAMPLE
+	// 4 bilinear taps cover the 4x4 input texels around the output texel.
+	// they're weighted by 1 / (1 + brightness) so a single very bright texel can't flicker through the bloom
+	vec2 o = prevPass_size.zw;
+	vec3 a = texture(prevPass, uv + vec2(-o.x, -o.y)).rgb;
+	vec3 b = texture(prevPass, uv + vec2( o.x, -o.y)).rgb;
+	vec3 c = texture(prevPass, uv + vec2(-o.x,  o.y)).rgb;
+	vec3 d = texture(prevPass, uv + vec2( o.x,  o.y)).rgb;
+	float wa = 1.0 / (1.0 + brightness(a));
+	float wb = 1.0 / (1.0 + brightness(b));
+	float wc = 1.0 / (1.0 + brightness(c));
+	float wd = 1.0 / (1.0 + brightness(d));
+	vec3 s = (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+#else
+	vec3 s = texture(prevPass, uv).rgb;
+#endif
+	color = vec4(prefilter(s), 1.0);
+}
@@ -0,0 +1,63 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 uv;
+
+uniform sampler2D image; // the pass groups' output, below full size
+
+float luma(vec3 c)
+{
+	return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+	vec2 size = vec2(textureSize(image, 0));
+	vec2 texel = 1.0 / size;
+	vec2 pos = uv * size;
+	vec2 center = floor(pos - 0.5) + 0.5; // the bottom left texel of the 2x2 around uv
+	vec2 f = pos - center;
+
+	// catmull-rom through 9 bilinear taps: the middle two texels of each axis are one tap, placed by their weights
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+	vec2 p0 = (center - 1.0) * texel;
+	vec2 p12 = (center + w2 / w12) * texel;
+	vec2 p3 = (center + 2.0) * texel;
+
+	vec4 cubic = vec4(0.0);
+	cubic += texture(image, vec2(p0.x,  p0.y))  * w0.x  * w0.y;
+	cubic += texture(image, vec2(p12.x, p0.y))  * w12.x * w0.y;
+	cubic += texture(image, vec2(p3.x,  p0.y))  * w3.x  * w0.y;
+	cubic += texture(image, vec2(p0.x,  p12.y)) * w0.x  * w12.y;
+	cubic += texture(image, vec2(p12.x, p12.y)) * w12.x * w12.y;
+	cubic += texture(image, vec2(p3.x,  p12.y)) * w3.x  * w12.y;
+	cubic += texture(image, vec2(p0.x,  p3.y))  * w0.x  * w3.y;
+	cubic += texture(image, vec2(p12.x, p3.y))  * w12.x * w3.y;
+	cubic += texture(image, vec2(p3.x,  p3.y))  * w3.x  * w3.y;
+
+	// the 2x2 texels around uv
+	ivec2 i = ivec2(center - 0.5);
+	ivec2 last = textureSize(image, 0) - 1;
+	vec4 a = texelFetch(image, clamp(i, ivec2(0), last), 0);
+	vec4 b = texelFetch(image, clamp(i + ivec2(1, 0), ivec2(0), last), 0);
+	vec4 c = texelFetch(image, clamp(i + ivec2(0, 1), ivec2(0), last), 0);
+	vec4 d = texelFetch(image, clamp(i + ivec2(1, 1), ivec2(0), last), 0);
+	vec4 lo = min(min(a, b), min(c, d));
+	vec4 hi = max(max(a, b), max(c, d));
+
+	// across an edge the cubic is sharp but stair-steps it. along the edge, two bilinear taps smooth the steps out
+	// without blurring across it
+	float la = luma(a.rgb), lb = luma(b.rgb), lc = luma(c.rgb), ld = luma(d.rgb);
+	vec2 gradient = vec2(lb + ld - la - lc, lc + ld - la - lb);
+	float strength = length(gradient) / (max(max(la, lb), max(lc, ld)) + 0.001);
+	vec2 along = vec2(-gradient.y, gradient.x) / (length(gradient) + 0.00001) * texel * 0.75;
+	vec4 edge = (texture(image, uv + along) + texture(image, uv - along)) * 0.5;
+
+	// the cubic's overshoot is clamped to the texels around it, so no halos
+	color = clamp(mix(cubic, edge, smoothstep(0.1, 0.5, strength) * 0.5), lo, hi);
+}
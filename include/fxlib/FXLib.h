@@ -11,15 +11,25 @@
 namespace FX
 {
 	FXLIB_API bool hasInitializedContext();
+	// with logging on, FXLib prints what went wrong when it has to skip something (a file it couldn't read, a shader that
+	// didn't build...) to the console. off by default. every message is printed once
+	FXLIB_API void setLogging(bool enabled);
+	FXLIB_API void logWarning(const std::string& message);
 }
 
 #include "utils.h"
+#include "GLState.h"
 #include "Shader.h"
+#include "ShaderLoader.h"
 #include "ShaderStorageBuffer.h"
 #include "TextureBuffer.h"
+#include "RenderTargetPool.h"
 #include "InstancedMeshRenderer.h"
-#include "ThreadPool.h"
+#include "HiZ.h"
+#include "JobSystem.h"
 #include "TrailRenderer.h"
+#include "TrailBatch.h"
 #include "ParticleSystem.h"
 #include "ShaderPatcher.h"
 #include "PostPass.h"
+#include "PostFX.h"
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include <array>
+
+namespace FX
+{
+	// shadows the GL bindings FXLib sets, so setting what is already bound costs no GL call and restoring needs no glGet.
+	// only calls made through here are seen: whatever ran outside FXLib (4D Miner, fdm::MeshRenderer, other mods, callbacks)
+	// may have changed anything, so FXLib's render functions `invalidate` first, and after calling out.
+	// mods mixing their own GL binds with these functions have to do the same
+	class FXLIB_API GLState
+	{
+	public:
+		inline static constexpr uint32_t TEXTURE_UNITS = 32;
+		inline static constexpr uint32_t BUFFER_BINDINGS = 16;
+
+		struct Blend
+		{
+			bool enabled = true;
+			GLenum equationRGB = GL_FUNC_ADD;
+			GLenum equationAlpha = GL_MAX;
+			GLenum srcRGB = GL_SRC_ALPHA;
+			GLenum dstRGB = GL_ONE_MINUS_SRC_ALPHA;
+			GLenum srcAlpha = GL_ONE;
+			GLenum dstAlpha = GL_ONE_MINUS_SRC_ALPHA;
+		};
+
+	private:
+		inline static constexpr uint32_t UNKNOWN = UINT32_MAX;
+		template<size_t N>
+		static constexpr std::array<uint32_t, N> unknown()
+		{
+			std::array<uint32_t, N> values{ };
+			values.fill(UNKNOWN);
+			return values;
+		}
+
+		inline static uint32_t framebuffer = UNKNOWN;
+		inline static uint32_t program = UNKNOWN;
+		inline static uint32_t vertexArray = UNKNOWN;
+		inline static uint32_t drawIndirectBuffer = UNKNOWN;
+		inline static std::array<uint32_t, TEXTURE_UNITS> textures = unknown<TEXTURE_UNITS>();
+		inline static std::array<uint32_t, BUFFER_BINDINGS> storageBuffers = unknown<BUFFER_BINDINGS>();
+		inline static std::array<uint32_t, BUFFER_BINDINGS> uniformBuffers = unknown<BUFFER_BINDINGS>();
+		static Blend blend;
+		inline static bool blendEnabledKnown = false;
+		inline static bool blendEquationKnown = false;
+		inline static bool blendFuncKnown = false;
+
+		static uint32_t* bufferBinding(GLenum target, uint32_t index);
+
+	public:
+		// what main.cpp sets up with the context, and what 4D Miner draws with. FXLib restores it after changing blending
+		static const Blend defaultBlend;
+
+		// forgets everything, so the next call of each kind is made for sure
+		static void invalidate();
+		// a deleted buffer is unbound from everything, and its name can come back for a new one
+		static void forgetBuffer(uint32_t buffer);
+		static void forgetVertexArray(uint32_t vao);
+
+		// `force` makes the call even if the shadow says it's already bound, for functions mods call between their own GL calls
+		static void bindFramebuffer(uint32_t fbo, bool force = false);
+		static void useProgram(uint32_t program, bool force = false);
+		static void bindVertexArray(uint32_t vao, bool force = false);
+		static void bindDrawIndirectBuffer(uint32_t buffer, bool force = false);
+		static void bindTextureUnit(uint32_t unit, uint32_t texture, bool force = false);
+		// only the range between the first and last unit that changed is rebound
+		static void bindTextures(uint32_t first, uint32_t count, const uint32_t* textures);
+		// GL_SHADER_STORAGE_BUFFER or GL_UNIFORM_BUFFER
+		static void bindBufferBase(GLenum target, uint32_t index, uint32_t buffer, bool force = false);
+		// the equations and factors are left alone while blending is disabled
+		static void setBlend(const Blend& blend);
+		static void setBlendEnabled(bool enabled);
+	};
+}
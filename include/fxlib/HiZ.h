@@ -0,0 +1,75 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include <memory>
+#include <mutex>
+
+namespace FX
+{
+	// min/max pyramids of framebuffers' depth, rebuilt in compute every frame when the framebuffer renders (see applyPostProcessing).
+	// level 0 is half the depth's size and every level halves again down to 1x1. r is the nearest depth under a texel, g the farthest.
+	// pass shaders of the framebuffer can sample it as `hiZ`, with `hiZ_size` the size of level 0.
+	// FX geometry is culled against the pyramid of the last frame, so something coming out from behind an occluder
+	// can show up a frame late
+	class FXLIB_API HiZ
+	{
+	public:
+		// a small level of the culling pyramid copied to the CPU, for culling on the CPU
+		struct Readback
+		{
+			int width = 0, height = 0;
+			std::vector<glm::vec2> depth{ };
+			glm::mat4 projection{ 1 };
+
+			// a view space sphere is behind the depth or off screen. false when it can't tell, like for spheres reaching behind the camera
+			bool isHidden(const glm::vec3& center, float radius) const;
+		};
+
+	private:
+		struct Pyramid
+		{
+			uint32_t tex = 0;
+			int width = 0, height = 0, levels = 0;
+		};
+		inline static std::unordered_map<const fdm::Framebuffer*, Pyramid> pyramids{ };
+		inline static const fdm::Framebuffer* cullTarget = nullptr;
+		inline static glm::mat4 projection{ 1 };
+		inline static bool hasProjection = false;
+
+		// the readback is copied into a buffer and only read once its fence passed, so it never waits for the GPU
+		inline static uint32_t readbackBuffer = 0;
+		inline static GLsync readbackFence = nullptr;
+		inline static glm::ivec2 pendingSize{ 0 };
+		inline static std::shared_ptr<const Readback> readback{ };
+		inline static std::mutex readbackMutex{ };
+
+		static void finishReadback();
+		static void startReadback(const Pyramid& pyramid);
+
+	public:
+		// hiz_build.comp, loaded in main.cpp
+		static const FX::Shader* buildShader;
+		// the readback is the first level at most this size on both axes
+		inline static int readbackSize = 64;
+
+		// builds the pyramid of `fb` on every render from now on. with `cull`, it's the one FX geometry is culled against
+		static void enable(fdm::Framebuffer& fb, bool cull = true);
+		static void disable(fdm::Framebuffer& fb);
+		// the pyramid texture of `fb`, 0 if it has none yet
+		static uint32_t getTexture(const fdm::Framebuffer& fb);
+		static glm::ivec2 getSize(const fdm::Framebuffer& fb);
+		// the projection FX geometry is drawn with (the `P` of the particle and trail shaders), since FXLib can't see 4D Miner's.
+		// nothing is culled before it's set
+		static void setProjection(const glm::mat4& projection);
+		static bool getProjection(glm::mat4& projection);
+		// the pyramid FX geometry is culled against, 0 if there is none
+		static uint32_t getCullTexture(int& levels);
+		// the latest readback of the culling pyramid, or nullptr. safe to keep and use from any thread
+		static std::shared_ptr<const Readback> getReadback();
+
+		// builds the pyramid if `fb` has one. called by the Framebuffer render hook
+		static void build(const fdm::Framebuffer& fb, uint32_t depthTex, int width, int height);
+		static void cleanup(const fdm::Framebuffer& fb);
+	};
+}
@@ -25,6 +25,11 @@ namespace FX
 		void updateMesh(const fdm::Mesh* mesh);
 		void render(const std::vector<void*>& instanceData);
 		void render() const;
+		// the draw `render` makes as a DrawElementsIndirectCommand (DrawArraysIndirectCommand without indices) with no instances,
+		// for a culling pass to count its instances into
+		std::array<uint32_t, 5> getIndirectCommand() const;
+		// draws the instances a culling pass wrote into `instances`, as many as `commandBuffer` says
+		void renderIndirect(uint32_t instances, uint32_t commandBuffer) const;
 		void updateData(const std::vector<void*>& instanceData);
 		void updateData(const void* instanceData, int instanceCount);
 		void setCount(int instanceCount = 1);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+namespace FX
+{
+	// work-stealing scheduler shared by everything in FXLib.
+	// every worker owns a deque: it pushes and pops at the back, idle workers steal from the front of the others.
+	// threads that aren't workers push into an extra shared deque. the workers are started on first use
+	class FXLIB_API JobSystem
+	{
+	public:
+		// counts the unfinished jobs started with it
+		struct Counter
+		{
+			std::atomic<size_t> pending{ 0 };
+
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+		};
+
+	private:
+		// a job stored inline: no allocation, so the callable has to be small and trivially copyable
+		// (lambdas capturing by reference or pointers are)
+		struct Task
+		{
+			inline static constexpr size_t STORAGE = 48;
+
+			alignas(std::max_align_t) unsigned char storage[STORAGE];
+			void (*invoke)(void* storage) = nullptr;
+			Counter* counter = nullptr;
+		};
+
+		struct Deque
+		{
+			inline static constexpr size_t CAPACITY = 1024;
+
+			std::mutex mutex;
+			Task tasks[CAPACITY];
+			size_t head = 0; // steal end
+			size_t tail = 0; // owner end
+
+			bool push(const Task& task);
+			bool pop(Task& task);
+			bool steal(Task& task);
+		};
+
+		std::vector<std::thread> workers;
+		std::unique_ptr<Deque[]> deques; // one per worker, then one for outside threads
+		size_t dequeCount = 0;
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		std::atomic<size_t> queued{ 0 };
+		std::atomic<bool> stop{ false };
+
+		JobSystem();
+		void workerLoop(size_t index);
+		void submit(const Task& task);
+		bool runOne(size_t home);
+		static void execute(Task& task);
+
+	public:
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// the shared instance, sized from std::thread::hardware_concurrency
+		static JobSystem& get();
+
+		// worker threads plus the thread waiting on them
+		size_t threadCount() const { return workers.size() + 1; }
+
+		// queues `func()`. `counter` is decremented once it has run
+		template<typename F>
+		void run(Counter& counter, const F& func);
+
+		// runs other jobs on the calling thread until `counter` reaches 0
+		void wait(Counter& counter);
+
+		// calls `func(chunkBegin, chunkEnd)` over [begin, end) split in chunks of `grain` items, and waits for all of them.
+		// a grain of 0 picks one that gives every thread a few chunks to balance the load
+		template<typename F>
+		void parallelFor(size_t begin, size_t end, const F& func, size_t grain = 0);
+	};
+
+	template<typename F>
+	void JobSystem::run(Counter& counter, const F& func)
+	{
+		static_assert(sizeof(F) <= Task::STORAGE, "capture less, or capture a pointer to the state");
+		static_assert(alignof(F) <= alignof(std::max_align_t));
+		static_assert(std::is_trivially_copyable_v<F>, "jobs are copied around as bytes");
+
+		Task task;
+		new (task.storage) F(func);
+		task.invoke = [](void* storage) { (*reinterpret_cast<F*>(storage))(); };
+		task.counter = &counter;
+
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		submit(task);
+	}
+
+	template<typename F>
+	void JobSystem::parallelFor(size_t begin, size_t end, const F& func, size_t grain)
+	{
+		if (end <= begin) return;
+
+		size_t count = end - begin;
+		if (!grain)
+			grain = glm::max(count / (threadCount() * 4), (size_t)1);
+
+		if (count <= grain)
+		{
+			func(begin, end);
+			return;
+		}
+
+		Counter counter;
+		const F* f = &func;
+		for (size_t chunk = begin; chunk < end; chunk += grain)
+		{
+			size_t chunkEnd = glm::min(chunk + grain, end);
+			run(counter, [f, chunk, chunkEnd]() { (*f)(chunk, chunkEnd); });
+		}
+		wait(counter);
+	}
+}
@@ -72,13 +72,31 @@ namespace FX
 
 	private:
 		InstancedMeshRenderer renderer;
+		// what survived `occlusionCulling`, and the indirect draw counting it
+		ShaderStorageBuffer visibleSSBO;
+		ShaderStorageBuffer commandSSBO;
 
 		size_t maxParticles = 100;
 		std::vector<Particle> particles;
 		std::vector<ParticleData> gpuData;
 
+		// `asyncUpdate` state. the update job writes `backData` and the trail mesh,
+		// `render` draws `frontData` and the mesh swapped in by `sync`
+		JobSystem::Counter updateJob;
+		bool updatePending = false;
+		std::vector<ParticleData> backData;
+		std::vector<ParticleData> frontData;
+		fdm::m4::Mat5 lastView{ 1 };
+		fdm::m4::Mat5 jobView{ 1 };
+		bool hasView = false;
+
+		void syncTrails();
+		void simulate(double dt);
+
 	public:
 		static const FX::Shader* defaultShader;
+		// particle_cull.comp, loaded in main.cpp
+		static const FX::Shader* cullShader;
 
 		const fdm::Shader* particleShader;
 		const fdm::Shader* trailShader;
@@ -100,6 +118,11 @@ namespace FX
 		ParticleSpace particleSpace = GLOBAL;
 		bool trails = false;
 		bool billboard = false;
+		// cull particles off screen, outside the view's slice or behind the depth of the last frame with a compute pass, before drawing.
+		// needs a HiZ pyramid to cull against and HiZ::setProjection. particles are taken as a unit cube around their position,
+		// scaled by `scale`. `cullMargin` grows that for bigger meshes
+		bool occlusionCulling = false;
+		float cullMargin = 0.f;
 
 		struct
 		{
@@ -117,6 +140,9 @@ namespace FX
 		// but it does still apply `p.vel` to `p.pos`, as well as `angleTowardsVelocity` to `pData.model` (all of this after running this function).
 		// `pData.model` gets set to `p.mat` after this func before applying angle and origin offset.
 		std::function<void(ParticleSystem* ps, Particle& p, ParticleData& pData, size_t i, double dt)> evalFunc = nullptr;
+		// set if `evalFunc` only touches its own particle, so particles can be updated on several threads.
+		// without an `evalFunc` they always are
+		bool evalFuncThreadSafe = false;
 		// if present, does not apply startVelocity or spawnModes.
 		// but it still does set the `velDeviation`, `startColor/endColor` (tho unused if `evalFunc` is present) and `lifetime` to `p`.
 		std::function<void(ParticleSystem* ps, Particle& p, ParticleData& pData, size_t i)> emitFunc = nullptr;
@@ -125,7 +151,14 @@ namespace FX
 
 		double lastEmitTime = 0.f;
 
-		~ParticleSystem() { particles.clear(); renderer.~InstancedMeshRenderer(); }
+		// run `update` on the job system while the previous frame renders.
+		// `update` waits for the last job and starts the next one, `render` only uploads and draws what that job produced,
+		// so everything is drawn one frame late and trails are meshed with the view of the previous `render`.
+		// `evalFunc` and the trail callbacks then run off the calling thread.
+		// call `sync` before reading or changing particles or trails directly
+		bool asyncUpdate = false;
+
+		~ParticleSystem() { sync(); particles.clear(); renderer.~InstancedMeshRenderer(); }
 		ParticleSystem() {}
 		ParticleSystem(const glm::vec4& origin, RND<float> lifetime, ParticleSpace particleSpace, size_t maxParticles);
 		ParticleSystem(
@@ -171,6 +204,8 @@ namespace FX
 		void initRenderer(const fdm::Mesh* mesh, const FX::Shader* particleShader, const FX::Shader* trailShader) { initRenderer(mesh, (const fdm::Shader*)particleShader, (const fdm::Shader*)trailShader); }
 		void update(double dt);
 		void render(const fdm::m4::Mat5& view);
+		// waits for the update job started by `update` when `asyncUpdate` is set, and makes its results the ones rendered
+		void sync();
 		ParticleSystem::Particle* emit(size_t count = 1);
 		size_t getMaxParticles() const { return maxParticles; }
 		size_t getAliveParticlesCount() const { return particles.size(); }
@@ -185,10 +220,26 @@ namespace FX
 		float getTrailLifetime() const { return trailRenderer.lifetime; }
 		void setTrailWidthFunc(const decltype(TrailRenderer::widthFunc)& widthFunc) { trailRenderer.widthFunc = widthFunc; }
 		void setTrailColorFunc(const decltype(TrailRenderer::colorFunc)& colorFunc) { trailRenderer.colorFunc = colorFunc; }
+		void setTrailWidthBatchFunc(const decltype(TrailRenderer::widthBatchFunc)& widthBatchFunc) { trailRenderer.widthBatchFunc = widthBatchFunc; }
+		void setTrailColorBatchFunc(const decltype(TrailRenderer::colorBatchFunc)& colorBatchFunc) { trailRenderer.colorBatchFunc = colorBatchFunc; }
+		void setTrailWidthCurve(const TrailRenderer::Curve<float>& widthCurve) { trailRenderer.widthCurve = widthCurve; }
+		void setTrailColorCurve(const TrailRenderer::Curve<glm::vec4>& colorCurve) { trailRenderer.colorCurve = colorCurve; }
 		void setTrailBillboard(bool billboard) { trailRenderer.billboard = billboard; }
 		bool getTrailBillboard() const { return trailRenderer.billboard; }
 		void setMinTrailPointDist(float minTrailPointDist) { trailRenderer.minTrailPointDist = minTrailPointDist; }
 		bool getMinTrailPointDist() const { return trailRenderer.minTrailPointDist; }
+		void setTrailSmooth(bool smooth) { trailRenderer.smooth = smooth; }
+		bool getTrailSmooth() const { return trailRenderer.smooth; }
+		void setTrailSubdivision(float density, uint32_t maxSubdivisions = 8) { trailRenderer.subdivisionDensity = density; trailRenderer.maxSubdivisions = maxSubdivisions; }
+		// see TrailRenderer::decimationTolerance
+		void setTrailDecimation(float tolerance) { trailRenderer.decimationTolerance = tolerance; }
+		float getTrailDecimation() const { return trailRenderer.decimationTolerance; }
+		void setTrailCulling(bool culling, float margin = 1.f) { trailRenderer.culling = culling; trailRenderer.cullMargin = margin; }
+		bool getTrailCulling() const { return trailRenderer.culling; }
+		// see TrailRenderer::occlusionCulling
+		void setTrailOcclusionCulling(bool culling) { trailRenderer.occlusionCulling = culling; }
+		// see TrailRenderer::memoryBudget, which only covers point storage
+		void setTrailMemoryBudget(size_t bytes) { trailRenderer.memoryBudget = bytes; }
 		void resetTrails() { trailRenderer.clearPoints(); }
 
 		ParticleSystem& operator=(const ParticleSystem& other);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include "PostPass.h"
+
+// ready-made post-processing effects, appended to a framebuffer's pass groups in its init callback.
+// the settings structs have to outlive the groups: their float values are the groups' uniforms, so they can be changed live.
+// the ints shape the groups, so changing those takes adding the effect again.
+// costs are texture fetches per output pixel, "full res" meaning the framebuffer's size.
+// they are counted from the shaders, not timed: none of the effects have been benchmarked on hardware yet
+namespace FX::PostFX
+{
+	struct Threshold
+	{
+		float threshold = 1.0f; // brightness (max of r, g, b) where the output starts growing linearly
+		float knee = 0.5f; // half the width of the soft curve around `threshold`
+	};
+
+	// downsamples by halves, then upsamples back to full res. the radius roughly doubles with every level.
+	// down levels cost 5 fetches and up levels 8, at 1/4 of the pixels of the level above.
+	// 4 levels is ~12 full res fetches per pixel in total, 8 of them in the last up level. the levels after that add little
+	struct KawaseBlur
+	{
+		int levels = 4;
+		float offset = 1.0f; // tap spread in texels, above ~1.5 it starts showing patterns
+	};
+
+	// two separable passes with the weights baked into the shader. neighbouring texels are read by one bilinear tap,
+	// so a radius r costs 1 + 2 * ceil(r / 2) fetches per pass: 9 per pass for r = 8, 17 for r = 16.
+	// prefer KawaseBlur for radii over ~16, or a sizeDiv of 2 (a quarter of the pixels).
+	// a sizeDiv above 1 adds a box downsample pass first, (sizeDiv / 2)^2 fetches at the blur's resolution
+	struct GaussianBlur
+	{
+		int radius = 8; // in texels of the blur's resolution. sigma is radius / 3
+		int sizeDiv = 1;
+	};
+
+	// threshold into half res, dual kawase down to 1 / 2^levels and back up to half res adding every level on the way,
+	// then the scene plus the bloom at full res. about 4.4 full res fetches per pixel for the bloom itself, +2 for the composite.
+	// the chains are R11F_G11F_B10F, so every fetch and write moves half the bytes of RGBA
+	struct Bloom
+	{
+		Threshold threshold{ };
+		int levels = 5; // at least 2
+		float offset = 1.0f;
+		float intensity = 0.05f;
+	};
+
+	// one pass at `sizeDiv`. with a sizeDiv above 1 it downsamples with 4 fetches, anti-flicker weighted
+	FXLIB_API void addThreshold(std::vector<PostPassGroup>& groups, Threshold& settings, int sizeDiv = 2);
+	// 2 mip chain groups, the second one's output is the blurred image
+	FXLIB_API void addKawaseBlur(std::vector<PostPassGroup>& groups, KawaseBlur& settings);
+	// 1 group, horizontal then vertical, after the downsample with a sizeDiv above 1
+	FXLIB_API void addGaussianBlur(std::vector<PostPassGroup>& groups, const GaussianBlur& settings);
+	// 3 groups, the last one's output is the scene with the bloom
+	FXLIB_API void addBloom(std::vector<PostPassGroup>& groups, Bloom& settings);
+}
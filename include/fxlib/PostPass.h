@@ -23,6 +23,11 @@ namespace FX
 		} type = FLOAT;
 		std::string name = "";
 		void* value = nullptr;
+
+		// std140 size and alignment in bytes, and the GLSL type
+		uint32_t getSize() const;
+		uint32_t getAlignment() const;
+		const char* getTypeName() const;
 	};
 
 	struct FXLIB_API PostPass
@@ -31,16 +36,33 @@ namespace FX
 		int sizeDiv = 1;
 		enum
 		{
+			// 16 bit floats
 			R,
 			RG,
 			RGB,
-			RGBA
+			RGBA,
+			R11F_G11F_B10F, // non-negative floats in 32 bits, with no alpha. half of RGBA for hdr colors
+			RGB10_A2, // [0, 1] with 10 bits per color and a 2 bit alpha
+			RGBA8, // [0, 1]
+			R8, // [0, 1], for masks
+			AUTO // the smallest of the above holding `channels` values in `range`
 		} passFormat = RGBA;
+		// what AUTO picks a format by
+		int channels = 4;
+		enum Range
+		{
+			HDR, // anything 16 bit floats hold
+			POSITIVE_HDR, // no negative values, like colors before tonemapping
+			LDR // [0, 1], like tonemapped colors
+		} range = HDR;
 
 		// internal stuff
-		uint32_t targetTex = 0;
+		uint32_t targetTex = 0; // borrowed from RenderTargetPool
 		int width = 1, height = 1;
 		void initTexture(int width, int height);
+		static GLenum getInternalFormat(decltype(passFormat) format);
+		// passFormat, with AUTO resolved
+		decltype(passFormat) getFormat() const;
 
 		PostPass() {}
 		PostPass(const fdm::Shader* shader, int sizeDiv = 1) :
@@ -52,13 +74,30 @@ namespace FX
 		void cleanup();
 		~PostPass();
 
+		// compiles in the background, groups are skipped until all their passes' shaders are ready
 		static const fdm::Shader* loadPassShader(const fdm::stl::string& name, const fdm::stl::string& fragmentPath);
+		// the same, with PostPassGroup::getUniformBlock(uniforms) added after the version line.
+		// the shader uses the uniforms without declaring them, and the group's values reach it through one uniform buffer
+		static const fdm::Shader* loadPassShader(const fdm::stl::string& name, const fdm::stl::string& fragmentPath, const std::vector<Uniform>& uniforms);
+		// a pass can also be a compute shader. it gets the same inputs, plus `targetSize`,
+		// and writes its target through `layout(binding = 0, <format>) uniform writeonly image2D`.
+		// it has to write every texel, and its target can't be RGB (there's no rgb16f image format).
+		// groups' clearing and blending don't apply to it
+		static const fdm::Shader* loadComputePassShader(const fdm::stl::string& name, const fdm::stl::string& computePath);
 	};
 
 	struct FXLIB_API PostPassGroup
 	{
 		using DrawCallback = std::add_pointer<void(PostPassGroup& pass)>::type;
 
+		// passes with this uniform block get `uniforms` through a std140 uniform buffer, uploaded only when a value changed.
+		// the others get them one by one with glProgramUniform
+		inline static constexpr const char* UNIFORM_BLOCK = "GroupUniforms";
+		// `layout(std140) uniform GroupUniforms { ... };` with a member per uniform, in order
+		static std::string getUniformBlock(const std::vector<Uniform>& uniforms);
+		// the std140 offset of every uniform. returns the size of the block
+		static uint32_t getUniformLayout(const std::vector<Uniform>& uniforms, std::vector<uint32_t>& offsets);
+
 		std::vector<PostPass> passes{ };
 		std::vector<Uniform> uniforms{ };
 		std::unordered_map<std::string, uint32_t> uniformTextures{ }; // uniform name -> texture id
@@ -114,7 +153,28 @@ namespace FX
 		} blending;
 
 		bool copyLastGroup = false; // blit last group's passes into this group's passes
+		// read last group's passes in place instead of copying them: until a pass of this group is drawn, `passN`, `curPass`,
+		// `prevPass` and `nextPass` are last group's pass N (the source for the first group), with its size in `_size`.
+		// the shaders resample them themselves, so there's no copy per pass. a pass' own texture doesn't start with
+		// last group's contents though, so blending or drawing without clearColor needs copyLastGroup, which wins if both are set
+		bool readLastGroup = false;
 		bool clearColor = true;
+		// render the passes into the mip levels of one texture instead of a texture each, for downsample/upsample chains.
+		// a pass draws into the level of size/sizeDiv, so sizeDiv has to be a power of 2, and every level uses the first pass' format.
+		// `passN` samples just pass N's level, and later groups get the whole texture as `p_group_chain`... for textureLod.
+		// the group itself only gets the single levels: the whole texture while drawing into one of its levels is a feedback loop.
+		// the texture only starts at the level of the pass with the smallest sizeDiv, which is level 0 for textureLod.
+		// with GENERATE, glGenerateTextureMipmap rebuilds every level below that one once the group is drawn
+		struct MipChain
+		{
+			enum Mode
+			{
+				DISABLED,
+				PASSES,
+				GENERATE
+			} mode = DISABLED;
+			int levels = 0; // with GENERATE, counted from the first level. 0 goes down to 1x1
+		} mipChain;
 
 		uint32_t targetFBO = 0;
 		uint32_t outputTex = 0;
@@ -138,4 +198,27 @@ namespace FX
 
 	using FramebufferInitCallback = std::add_pointer<void(uint32_t fbo, uint32_t colorTex, uint32_t depthTex, int width, int height, std::vector<PostPassGroup>& passGroups)>::type;
 	FXLIB_API void applyPostProcessing(fdm::Framebuffer& fb, FramebufferInitCallback initCallback);
+	// the pass groups are compiled into a plan with every uniform location and texture binding resolved.
+	// adding/removing groups, passes, uniforms or uniform textures is noticed on its own;
+	// call this after changing anything else the plan was built from, like a uniform's name
+	FXLIB_API void invalidatePostProcessing(fdm::Framebuffer& fb);
+	// the format of the framebuffer's color texture, GL_RGB16F or GL_RGBA16F by default for hdr.
+	// like applyPostProcessing, it has to be called before the framebuffer is initialized
+	FXLIB_API void setFramebufferFormat(fdm::Framebuffer& fb, GLenum internalFormat);
+
+	// runs the pass groups at a fraction of the framebuffer's size, picked from the GPU time they took over the last frames.
+	// sizeDivs apply on top of the scale, while `source`, `sourceDepth` and `sourceSize` stay at full size.
+	// below a scale of 1 the output is brought back to full size by an edge-adaptive upscale (15 fetches per pixel)
+	// before it's drawn. group outputs and callbacks see the scaled textures
+	struct DynamicResolution
+	{
+		bool enabled = false;
+		float budgetMs = 4.0f; // GPU time the pass groups should take per frame
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		float step = 0.125f; // the scale changes in steps of this, since every change rebuilds the passes' textures
+	};
+	FXLIB_API void setDynamicResolution(fdm::Framebuffer& fb, const DynamicResolution& settings);
+	// the scale the pass groups currently run at
+	FXLIB_API float getResolutionScale(fdm::Framebuffer& fb);
 }
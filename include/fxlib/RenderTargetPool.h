@@ -0,0 +1,48 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include <map>
+
+namespace FX
+{
+	// immutable (glTextureStorage2D) render target textures, reused by (width, height, format, levels).
+	// released textures are kept for `keepTime` seconds, so resizing back and forth doesn't reallocate
+	class FXLIB_API RenderTargetPool
+	{
+	private:
+		struct Target
+		{
+			uint64_t key = 0;
+			uint32_t refs = 1;
+			uint32_t slot = UINT32_MAX; // for shared targets
+		};
+		struct Free
+		{
+			uint32_t tex = 0;
+			double releaseTime = 0;
+		};
+
+		inline static std::unordered_map<uint32_t, Target> targets{ };
+		inline static std::unordered_map<uint64_t, std::vector<Free>> freeTargets{ };
+		inline static std::map<std::pair<uint64_t, uint32_t>, uint32_t> sharedTargets{ };
+
+		static uint64_t makeKey(int width, int height, GLenum internalFormat, int levels);
+		static uint32_t create(int width, int height, GLenum internalFormat, int levels);
+		static uint32_t take(uint64_t key, int width, int height, GLenum internalFormat, int levels);
+
+	public:
+		inline static double keepTime = 2.0;
+
+		// a texture only the caller uses. with more than one level it samples the nearest mip
+		static uint32_t acquire(int width, int height, GLenum internalFormat, int levels = 1);
+		// the same texture for everyone asking for the same size, format and `slot`.
+		// for targets whose contents are only needed while one framebuffer renders, so framebuffers can share them
+		static uint32_t acquireShared(int width, int height, GLenum internalFormat, uint32_t slot);
+		// returns a texture to the pool. textures that didn't come from it are deleted
+		static void release(uint32_t tex);
+		// deletes the textures that stayed unused for longer than `keepTime`, or all unused ones
+		static void trim(bool all = false);
+		static size_t getTextureCount();
+	};
+}
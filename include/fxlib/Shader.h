@@ -12,13 +12,15 @@ namespace FX
 		uint32_t ID;
 
 	public:
+		Shader(uint32_t id = 0) : ID(id) {}
+
 		uint32_t id() const
 		{
 			return ID;
 		}
 		void use() const
 		{
-			glUseProgram(ID);
+			GLState::useProgram(ID, true);
 		}
 
 		int getUniformLocation(const std::string& name) const
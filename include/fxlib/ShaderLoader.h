@@ -0,0 +1,71 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include "Shader.h"
+
+#include <unordered_set>
+
+namespace FX
+{
+	// loads shader programs that fdm::ShaderManager can't build (compute shaders), and programs compiled in the background.
+	// paths are relative to FXLib's mod folder, same as with fdm::ShaderManager::load.
+	// programs are also listed in fdm::ShaderManager under their name, so ShaderManager::get finds them,
+	// but one from an async load may still be compiling there: check `isReady` before drawing with it
+	class FXLIB_API ShaderLoader
+	{
+	public:
+		using Stages = std::vector<std::pair<GLenum, std::string>>; // stage type -> source
+
+	private:
+		// a program whose compile and link were queued without checking the result yet
+		struct Pending
+		{
+			std::string name;
+			std::vector<uint32_t> stages;
+			uint64_t cacheKey = 0; // where to store the binary once linked. 0 if it isn't cached
+		};
+
+		inline static std::unordered_map<std::string, FX::Shader*> shaders{ };
+		inline static std::unordered_map<uint32_t, Pending> pending{ }; // program -> stages still attached
+		inline static std::unordered_set<uint32_t> failed{ };
+		inline static std::unordered_set<uint32_t> computePrograms{ };
+		inline static std::unordered_set<std::string> managerShaders{ }; // names also listed in fdm::ShaderManager::shaders
+		inline static bool parallelCompile = false;
+		inline static bool initialized = false;
+
+		static void init();
+		static const FX::Shader* addShader(const std::string& name, uint32_t program);
+		static void removeShader(const std::string& name);
+		static uint32_t queueProgram(const Stages& stages);
+		static bool finishProgram(uint32_t program);
+		static uint64_t getCacheKey(const Stages& stages);
+		static std::string getCachePath(uint64_t key);
+		static uint32_t loadBinary(uint64_t key);
+		static void storeBinary(uint32_t program, uint64_t key);
+
+	public:
+		// reuse the driver's compiled programs between launches. they are stored in `shaderCache/` in FXLib's mod folder,
+		// keyed by the sources and the GL vendor, renderer and version. a binary the driver rejects is rebuilt from source
+		inline static bool binaryCache = true;
+
+		// reads a file relative to FXLib's mod folder
+		static bool readFile(const std::string& path, std::string& source);
+		static const FX::Shader* loadCompute(const std::string& name, const std::string& computePath);
+		// queues the compile and returns right away. the program can't be used before `isReady` returns true.
+		// with GL_KHR/ARB_parallel_shader_compile the driver compiles on its own threads
+		static const FX::Shader* loadFromSource(const std::string& name, const Stages& stages);
+		static const FX::Shader* loadAsync(const std::string& name, const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath = "");
+		static const FX::Shader* loadComputeAsync(const std::string& name, const std::string& computePath);
+		// true once the program is linked. never blocks when parallel compiling is supported.
+		// programs that didn't come from an async load are always ready, ones that failed to build never are
+		static bool isReady(const fdm::Shader* shader);
+		static bool isReady(const FX::Shader* shader) { return isReady((const fdm::Shader*)shader); }
+		// blocks until the program is built. returns false if it failed
+		static bool wait(const fdm::Shader* shader);
+		static bool wait(const FX::Shader* shader) { return wait((const fdm::Shader*)shader); }
+		// the program was loaded here from a compute shader
+		static bool isCompute(const fdm::Shader* shader);
+		static const FX::Shader* get(const std::string& name);
+	};
+}
@@ -40,7 +40,7 @@ namespace FX
 		{
 			if (ID)
 			{
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, ID);
+				GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, index, ID, true);
 			}
 		}
 
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "FXLib.h"
+
+#if defined(__AVX__) || defined(__AVX2__)
+#define FXLIB_SIMD_AVX
+#define FXLIB_SIMD_SSE
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FXLIB_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+// batch kernels for the hot 4D math of trail meshing.
+// the math is written once over a lane type (float, __m128, __m256), points are transposed into lanes on load.
+// loads and stores take the distance between two points in bytes, so they can run over a field of an array of structs.
+// with AVX 8 points are processed per iteration, with SSE 4, and the rest goes through the scalar version
+namespace FX::simd
+{
+	// one 4D vector per lane
+	template<typename F>
+	struct Vec4
+	{
+		F x, y, z, w;
+	};
+
+	inline float add(float a, float b) { return a + b; }
+	inline float sub(float a, float b) { return a - b; }
+	inline float mul(float a, float b) { return a * b; }
+	inline float div(float a, float b) { return a / b; }
+	inline float sqrt(float a) { return std::sqrt(a); }
+	template<typename F> F splat(float v);
+	template<> inline float splat<float>(float v) { return v; }
+	template<typename F> F loadScalars(const float* p);
+	template<> inline float loadScalars<float>(const float* p) { return *p; }
+
+	// the `i`th point after `p`
+	inline const float* at(const glm::vec4* p, size_t i, size_t stride) { return (const float*)((const char*)p + i * stride); }
+	inline float* at(glm::vec4* p, size_t i, size_t stride) { return (float*)((char*)p + i * stride); }
+
+	template<typename F>
+	inline Vec4<F> load(const glm::vec4* p, size_t stride = sizeof(glm::vec4)) { return { p->x, p->y, p->z, p->w }; }
+	template<typename F>
+	inline void store(glm::vec4* p, const Vec4<F>& v, size_t stride = sizeof(glm::vec4)) { *p = { v.x, v.y, v.z, v.w }; }
+
+#ifdef FXLIB_SIMD_SSE
+	inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+	inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+	inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+	inline __m128 div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+	inline __m128 sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+	template<> inline __m128 splat<__m128>(float v) { return _mm_set1_ps(v); }
+	template<> inline __m128 loadScalars<__m128>(const float* p) { return _mm_loadu_ps(p); }
+
+	template<>
+	inline Vec4<__m128> load<__m128>(const glm::vec4* p, size_t stride)
+	{
+		__m128 r0 = _mm_loadu_ps(at(p, 0, stride));
+		__m128 r1 = _mm_loadu_ps(at(p, 1, stride));
+		__m128 r2 = _mm_loadu_ps(at(p, 2, stride));
+		__m128 r3 = _mm_loadu_ps(at(p, 3, stride));
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		return { r0, r1, r2, r3 };
+	}
+	template<>
+	inline void store<__m128>(glm::vec4* p, const Vec4<__m128>& v, size_t stride)
+	{
+		__m128 r0 = v.x, r1 = v.y, r2 = v.z, r3 = v.w;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(at(p, 0, stride), r0);
+		_mm_storeu_ps(at(p, 1, stride), r1);
+		_mm_storeu_ps(at(p, 2, stride), r2);
+		_mm_storeu_ps(at(p, 3, stride), r3);
+	}
+#endif
+
+#ifdef FXLIB_SIMD_AVX
+	inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	inline __m256 div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+	inline __m256 sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+	template<> inline __m256 splat<__m256>(float v) { return _mm256_set1_ps(v); }
+	template<> inline __m256 loadScalars<__m256>(const float* p) { return _mm256_loadu_ps(p); }
+
+	// points 0-3 go to the low half of the lanes, 4-7 to the high half, then both halves are transposed at once
+	inline void transpose8x4(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+		r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+	template<>
+	inline Vec4<__m256> load<__m256>(const glm::vec4* p, size_t stride)
+	{
+		auto pair = [p, stride](int i) { return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(at(p, i, stride))), _mm_loadu_ps(at(p, i + 4, stride)), 1); };
+		__m256 r0 = pair(0), r1 = pair(1), r2 = pair(2), r3 = pair(3);
+		transpose8x4(r0, r1, r2, r3);
+		return { r0, r1, r2, r3 };
+	}
+	template<>
+	inline void store<__m256>(glm::vec4* p, const Vec4<__m256>& v, size_t stride)
+	{
+		__m256 r[4]{ v.x, v.y, v.z, v.w };
+		transpose8x4(r[0], r[1], r[2], r[3]);
+		for (int i = 0; i < 4; ++i)
+		{
+			_mm_storeu_ps(at(p, i, stride), _mm256_castps256_ps128(r[i]));
+			_mm_storeu_ps(at(p, i + 4, stride), _mm256_extractf128_ps(r[i], 1));
+		}
+	}
+#endif
+
+	template<typename F>
+	inline Vec4<F> splat4(const glm::vec4& v) { return { splat<F>(v.x), splat<F>(v.y), splat<F>(v.z), splat<F>(v.w) }; }
+	template<typename F>
+	inline Vec4<F> add(const Vec4<F>& a, const Vec4<F>& b) { return { add(a.x, b.x), add(a.y, b.y), add(a.z, b.z), add(a.w, b.w) }; }
+	template<typename F>
+	inline Vec4<F> sub(const Vec4<F>& a, const Vec4<F>& b) { return { sub(a.x, b.x), sub(a.y, b.y), sub(a.z, b.z), sub(a.w, b.w) }; }
+	template<typename F>
+	inline Vec4<F> mul(const Vec4<F>& a, F b) { return { mul(a.x, b), mul(a.y, b), mul(a.z, b), mul(a.w, b) }; }
+
+	// same as m4::cross
+	template<typename F>
+	inline Vec4<F> cross(const Vec4<F>& u, const Vec4<F>& v, const Vec4<F>& w)
+	{
+		F a = sub(mul(v.x, w.y), mul(v.y, w.x));
+		F b = sub(mul(v.x, w.z), mul(v.z, w.x));
+		F c = sub(mul(v.x, w.w), mul(v.w, w.x));
+		F d = sub(mul(v.y, w.z), mul(v.z, w.y));
+		F e = sub(mul(v.y, w.w), mul(v.w, w.y));
+		F f = sub(mul(v.z, w.w), mul(v.w, w.z));
+
+		return {
+			add(sub(mul(u.y, f), mul(u.z, e)), mul(u.w, d)),
+			sub(sub(mul(u.z, c), mul(u.x, f)), mul(u.w, b)),
+			add(sub(mul(u.x, e), mul(u.y, c)), mul(u.w, a)),
+			sub(sub(mul(u.y, b), mul(u.x, d)), mul(u.z, a))
+		};
+	}
+
+	template<typename F>
+	inline Vec4<F> normalize(const Vec4<F>& v)
+	{
+		F len = sqrt(add(add(mul(v.x, v.x), mul(v.y, v.y)), add(mul(v.z, v.z), mul(v.w, v.w))));
+		F inv = div(splat<F>(1.f), len);
+		return { mul(v.x, inv), mul(v.y, inv), mul(v.z, inv), mul(v.w, inv) };
+	}
+
+	// runs `kernel.template operator()<F>(i)` over [0, count) with the widest lane type available
+	template<typename Kernel>
+	inline void forEach(size_t count, Kernel&& kernel)
+	{
+		size_t i = 0;
+#ifdef FXLIB_SIMD_AVX
+		for (; i + 8 <= count; i += 8)
+			kernel.template operator()<__m256>(i);
+#endif
+#ifdef FXLIB_SIMD_SSE
+		for (; i + 4 <= count; i += 4)
+			kernel.template operator()<__m128>(i);
+#endif
+		for (; i < count; ++i)
+			kernel.template operator()<float>(i);
+	}
+
+	// the cached frame of trail points, as TrailRenderer::updateFrames builds it for every point but the last.
+	// `pos`, `normal` and `tangent` point into `count + 1` points `stride` bytes apart, the outputs into `count` of them
+	inline void pointFrames(const glm::vec4* pos, const glm::vec4* normal, const glm::vec4* tangent, size_t stride, size_t count,
+		glm::vec4* dir, glm::vec4* forward, glm::vec4* up, glm::vec4* diagA, glm::vec4* diagB)
+	{
+		forEach(count, [&]<typename F>(size_t i) {
+			auto in = [&](const glm::vec4* p, size_t k) { return load<F>((const glm::vec4*)at(p, k, stride), stride); };
+			auto out = [&](glm::vec4* p) { return (glm::vec4*)at(p, i, stride); };
+
+			Vec4<F> d = normalize(sub(in(pos, i + 1), in(pos, i)));
+			Vec4<F> f = normalize(in(normal, i));
+			Vec4<F> u = normalize(in(tangent, i));
+			Vec4<F> o = normalize(cross(d, f, u));
+
+			store<F>(out(dir), d, stride);
+			store<F>(out(forward), f, stride);
+			store<F>(out(up), u, stride);
+			store<F>(out(diagA), add(u, o), stride);
+			store<F>(out(diagB), sub(u, o), stride);
+		});
+	}
+
+	// the camera-facing frame of every trail direction, as built by TrailRenderer for billboard trails
+	inline void billboardFrames(const glm::vec4* dirs, size_t count, const glm::vec4& camForward, const glm::vec4& camOver,
+		glm::vec4* forward, glm::vec4* up, glm::vec4* diagA, glm::vec4* diagB)
+	{
+		forEach(count, [&]<typename F>(size_t i) {
+			Vec4<F> over = splat4<F>(camOver);
+			Vec4<F> dir = load<F>(dirs + i);
+
+			Vec4<F> u = normalize(cross(dir, splat4<F>(camForward), over));
+			Vec4<F> f = normalize(cross(dir, u, over));
+			Vec4<F> o = normalize(cross(dir, f, u));
+
+			store<F>(forward + i, f);
+			store<F>(up + i, u);
+			store<F>(diagA + i, add(u, o));
+			store<F>(diagB + i, sub(u, o));
+		});
+	}
+
+	// the 4 corners of each point's ring: center +diagA, +diagB, -diagB, -diagA, all scaled by `scale`.
+	// written to `corners[i * stride + 0..3]`
+	inline void ringCorners(const glm::vec4* centers, const glm::vec4* diagA, const glm::vec4* diagB, const float* scale, size_t count,
+		glm::vec4* corners, size_t stride)
+	{
+		const size_t ring = stride * sizeof(glm::vec4);
+		forEach(count, [&]<typename F>(size_t i) {
+			F s = loadScalars<F>(scale + i);
+			Vec4<F> c = load<F>(centers + i);
+			Vec4<F> a = mul(load<F>(diagA + i), s);
+			Vec4<F> b = mul(load<F>(diagB + i), s);
+
+			glm::vec4* out = corners + i * stride;
+			store<F>(out + 0, add(c, a), ring);
+			store<F>(out + 1, add(c, b), ring);
+			store<F>(out + 2, sub(c, b), ring);
+			store<F>(out + 3, sub(c, a), ring);
+		});
+	}
+}
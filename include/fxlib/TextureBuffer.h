@@ -87,7 +87,7 @@ namespace FX
 		{
 			if (ID)
 			{
-				glBindTextureUnit(unit, ID);
+				GLState::bindTextureUnit(unit, ID, true);
 			}
 		}
 		
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "FXLib.h"
+
+#include "ShaderStorageBuffer.h"
+#include "TrailRenderer.h"
+
+namespace FX
+{
+	// draws the meshes of many TrailRenderers sharing a shader with one upload and one multi-draw.
+	// renderers added to a batch should have `batched` set, so they don't upload their mesh themselves
+	class FXLIB_API TrailBatch
+	{
+	public:
+		// per-renderer parameters, read by the shader through `drawID`
+		struct Params
+		{
+			glm::vec4 tint{ 1 };
+		};
+
+	private:
+		struct Entry
+		{
+			const TrailRenderer* renderer;
+			Params params;
+		};
+		// DrawElementsIndirectCommand
+		struct Command
+		{
+			uint32_t count;
+			uint32_t instanceCount;
+			uint32_t firstIndex;
+			int32_t baseVertex;
+			uint32_t baseInstance;
+		};
+
+		std::vector<Entry> entries{ };
+		std::vector<Command> commands{ };
+		std::vector<Params> params{ };
+		std::vector<uint32_t> drawIDs{ };
+		ShaderStorageBuffer vertexBuffer{ };
+		ShaderStorageBuffer indexBuffer{ };
+		ShaderStorageBuffer commandBuffer{ };
+		ShaderStorageBuffer paramBuffer{ };
+		ShaderStorageBuffer drawIDBuffer{ };
+		uint32_t VAO = 0;
+
+	public:
+		// trail_batch.vert with the default trail geometry and fragment shaders. loaded in main.cpp
+		static const FX::Shader* defaultShader;
+
+		const fdm::Shader* shader = nullptr;
+		GLenum mode = GL_LINES_ADJACENCY;
+
+		TrailBatch(const fdm::Shader* shader = nullptr);
+		~TrailBatch();
+
+		// queues the current mesh of `renderer` for the next render()
+		void add(const TrailRenderer& renderer, const Params& params);
+		void add(const TrailRenderer& renderer);
+		// draws and clears everything queued since the last call
+		void render(const fdm::m4::Mat5& view);
+		size_t getQueuedCount() const;
+
+		TrailBatch(const TrailBatch&) = delete;
+		TrailBatch& operator=(const TrailBatch&) = delete;
+	};
+}
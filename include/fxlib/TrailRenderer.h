@@ -2,7 +2,11 @@
 
 #include "FXLib.h"
 
-#include "ThreadPool.h"
+#include "JobSystem.h"
+#include "ShaderStorageBuffer.h"
+
+#include <span>
+#include <atomic>
 
 namespace FX
 {
@@ -18,16 +22,40 @@ namespace FX
 			bool createdByTrail = false;
 			float width;
 			glm::vec4 color;
+
+			// cached frame, only rebuilt when this point or its neighbour changes
+			glm::vec4 dir{ 0 };
+			glm::vec4 forward{ 0 };
+			glm::vec4 up{ 0 };
+			glm::vec4 diagA{ 0 }; // up + over
+			glm::vec4 diagB{ 0 }; // up - over
 		};
 		
 		struct Trail
 		{
+			inline static constexpr size_t CLEAN = SIZE_MAX;
+			inline static constexpr size_t MAX_DECIMATED = 16;
+
 			std::vector<TrailPoint> points{ };
 			glm::vec4 pos{ 0 };
 			glm::vec4 normal{ 0 };
 			glm::vec4 tangent{ 0 };
+			size_t dirtyFrom = CLEAN; // first point whose cached frame is stale
+			std::vector<glm::vec4> decimated{ }; // points dropped since the second to last point
+			// 4D box around the points, grown as points are added and rebuilt after some expire
+			glm::vec4 boundsMin{ 0 };
+			glm::vec4 boundsMax{ 0 };
+			bool boundsDirty = true;
+			bool visible = true;
 
-			Trail(size_t maxPoints = 0) { points.reserve(maxPoints); }
+			void invalidate(size_t from) { dirtyFrom = glm::min(dirtyFrom, from); }
+			bool isDirty() const { return dirtyFrom != CLEAN; }
+			void expandBounds(const glm::vec4& p)
+			{
+				if (boundsDirty) return;
+				boundsMin = glm::min(boundsMin, p);
+				boundsMax = glm::max(boundsMax, p);
+			}
 		};
 
 		class TrailMesh : public fdm::Mesh
@@ -38,6 +66,8 @@ namespace FX
 				glm::vec4 pos{ 0 }, normal{ 0 }, tangent{ 0 }, biTangent{ 0 }, color{ 1 };
 				glm::vec3 uvw;
 			};
+			// mirrored as `float data[23]` in trail_smooth.comp
+			static_assert(sizeof(Vert) == 23 * sizeof(float));
 			std::vector<Vert> vertices{ };
 			std::vector<uint32_t> indices{ };
 
@@ -58,26 +88,149 @@ namespace FX
 		TrailMesh mesh{ };
 		fdm::MeshRenderer renderer{ };
 		size_t maxPointsPerTrail = 0;
-		inline static ThreadPool threadPool{ 4 };
+		std::atomic<size_t> memoryUsage{ 0 }; // bytes reserved for points
+		inline static std::atomic<size_t> globalMemoryUsage{ 0 };
+		// smoothShader finished compiling. checked on the GL thread in uploadMesh, since buildMesh may run on a job
+		inline static std::atomic<bool> smoothReady{ false };
+		// a piece of trail between the vertex rings `rings[1]` and `rings[2]`, with their neighbours for the curve
+		struct Segment
+		{
+			inline static constexpr uint32_t FIRST = 1;
+			inline static constexpr uint32_t LAST = 2;
+
+			uint32_t rings[4];
+			uint32_t flags;
+		};
+		std::vector<Segment> segments{ };
+		bool smoothing = false;
+		fdm::m4::Mat5 meshView{ 1 };
+		bool meshTesseractal = false;
+		bool meshDirty = false; // swapped in but not uploaded yet
+		// the output of buildMesh. swapMesh makes it the current mesh,
+		// so the next one can be built on another thread while the current one is drawn
+		struct
+		{
+			std::vector<TrailMesh::Vert> vertices{ };
+			std::vector<uint32_t> indices{ };
+			std::vector<Segment> segments{ };
+			fdm::m4::Mat5 view{ 1 };
+			bool smoothing = false;
+			bool tesseractal = false;
+			bool ready = false;
+		} built{ };
+		ShaderStorageBuffer controlBuffer{ };
+		ShaderStorageBuffer segmentBuffer{ };
+		ShaderStorageBuffer patternBuffer{ };
+		ShaderStorageBuffer smoothVertices{ };
+		ShaderStorageBuffer smoothIndices{ };
+		ShaderStorageBuffer commandBuffer{ };
+		uint32_t smoothVAO = 0;
+
+		static void updateFrames(Trail& trail);
+		static void updateBounds(Trail& trail);
+		bool claimMemory(size_t bytes);
+		void releaseMemory(size_t bytes);
+		bool growPoints(Trail& trail);
+		void freePoints(Trail& trail);
+		void recountMemory();
+		bool isVisible(const Trail& trail, const fdm::m4::Mat5& view, const HiZ::Readback* occlusion) const;
+		void meshTrails(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver, const fdm::m4::Mat5* view);
+		void smoothMesh(const fdm::m4::Mat5& view, uint32_t ringSize, std::span<const uint32_t> capPattern, std::span<const uint32_t> segmentPattern);
+		void evalAttributes(const float* t, const float* p, const size_t* trailIDs, size_t count, float* widths, glm::vec4* colors) const;
 
 	public:
 		static const FX::Shader* defaultShader;
+		// compute shader used by `smooth`. loaded in main.cpp
+		static const FX::Shader* smoothShader;
 
 		inline static float defaultWidth(float t, float p, size_t trailID, void* user) { return 1.f; }
 		inline static glm::vec4 defaultColor(float t, float p, size_t trailID, void* user) { return { 1.f, 1.f, 1.f, p }; }
 
+		// built-in width/color presets, evaluated without any callbacks.
+		// the value is `start + (end - start) * x`, where x depends on `input`
+		template<typename T>
+		struct Curve
+		{
+			enum Input
+			{
+				CONSTANT,		// x = 0
+				AGE,			// x = t
+				POSITION,		// x = p
+				POSITION_FADE	// x = p * (1 - t)
+			} input = CONSTANT;
+			T start{ 1 };
+			T end{ 1 };
+
+			T eval(float t, float p) const
+			{
+				switch (input)
+				{
+				case AGE: return start + (end - start) * t;
+				case POSITION: return start + (end - start) * p;
+				case POSITION_FADE: return start + (end - start) * (p * (1.f - t));
+				}
+				return start;
+			}
+		};
+
 		float lifetime = 1.f;
-		std::function<float(float t, float p, size_t trailID, void* user)> widthFunc = defaultWidth;
-		std::function<glm::vec4(float t, float p, size_t trailID, void* user)> colorFunc = defaultColor;
+		// per-point callbacks. used when the batch versions below are not set
+		std::function<float(float t, float p, size_t trailID, void* user)> widthFunc = nullptr;
+		std::function<glm::vec4(float t, float p, size_t trailID, void* user)> colorFunc = nullptr;
+		// batch callbacks. called once per meshing job with the `t`, `p` and trail ID of every point of the job's trails.
+		// they must fill `count` values of `widths`/`colors`. take priority over `widthFunc`/`colorFunc`
+		std::function<void(const float* t, const float* p, const size_t* trailIDs, size_t count, float* widths, void* user)> widthBatchFunc = nullptr;
+		std::function<void(const float* t, const float* p, const size_t* trailIDs, size_t count, glm::vec4* colors, void* user)> colorBatchFunc = nullptr;
+		// used when no width/color callbacks are set
+		Curve<float> widthCurve{ Curve<float>::CONSTANT, 1.f, 1.f };
+		Curve<glm::vec4> colorCurve{ Curve<glm::vec4>::POSITION, glm::vec4{ 1.f, 1.f, 1.f, 0.f }, glm::vec4{ 1.f } };
 		void* user = nullptr;
 		bool billboard = false;
 		bool tesseractal = false;
 		float minTrailPointDist = 0.1f;
+		// when above 0, a new point replaces the previous one if every point dropped that way
+		// stays within this distance of the resulting straight segment
+		float decimationTolerance = 0.f;
+		// skip trails whose bounds can't reach the view's slice (w = 0) or are behind the camera.
+		// only done when the view is passed to updateMesh.
+		// `cullMargin` grows the bounds and has to cover half of the widest trail width, so it's off by default
+		bool culling = false;
+		float cullMargin = 1.f;
+		// with `culling`, also skip trails off screen or behind the depth of HiZ's readback (see HiZ::getReadback)
+		bool occlusionCulling = false;
+		// bytes of point storage (the TrailPoints) this renderer may reserve. 0 means no limit.
+		// trails grow their storage on demand up to `maxPointsPerTrail`; when the budget (or `globalMemoryBudget`)
+		// runs out, a trail that can't grow recycles its oldest point instead.
+		// the mesh built from the points isn't counted: it takes roughly ringSize vertices and the segment pattern's
+		// indices per point
+		size_t memoryBudget = 0;
+		// the same, shared by all trail renderers. also only counts point storage
+		inline static size_t globalMemoryBudget = 0;
+		// treat the points as control points of a Catmull-Rom curve and subdivide it on the GPU.
+		// lets trails stay smooth with a much larger `minTrailPointDist`. needs the view passed to updateMesh
+		bool smooth = false;
+		// the mesh is drawn by a TrailBatch, so updateMesh doesn't upload it to this renderer
+		bool batched = false;
+		// subdivisions per unit of projected segment length (roughly radians of the field of view)
+		float subdivisionDensity = 50.f;
+		// segments are always split into an odd number of pieces, so an even limit rounds down
+		uint32_t maxSubdivisions = 8;
 
+		// no point storage is allocated up front
 		TrailRenderer(size_t maxPointsPerTrail = 100, size_t trails = 1);
+		~TrailRenderer();
 		void initRenderer();
 		void update();
+		// buildMesh, swapMesh and uploadMesh in one go
 		void updateMesh(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver);
+		void updateMesh(const fdm::m4::Mat5& view);
+		// meshes the trails on the CPU without touching the mesh being drawn or OpenGL, so it can run on a worker thread
+		void buildMesh(const glm::vec4& camLeft, const glm::vec4& camUp, const glm::vec4& camForward, const glm::vec4& camOver);
+		void buildMesh(const fdm::m4::Mat5& view);
+		// makes the last built mesh the current one. returns false if nothing was built since the last swap
+		bool swapMesh();
+		// uploads the current mesh if it changed, and runs the smoothing pass. needs the GL context
+		void uploadMesh();
 		bool addPoint(const glm::vec4& pos, const glm::vec4& normal, const glm::vec4& tangent, size_t trailID = 0, float timeOffset = 0);
 		const std::vector<TrailPoint>& getPoints(size_t trailID = 0) const;
 		size_t getPointCount(size_t trailID) const;
@@ -90,6 +243,13 @@ namespace FX
 		void render() const;
 		size_t getVertexCount() const;
 		size_t getIndexCount() const;
+		// bytes of point storage reserved, what `memoryBudget` limits
+		size_t getMemoryUsage() const;
+		const TrailMesh& getMesh() const { return mesh; }
+		// the last updateMesh went through the compute pass, so the mesh only exists on the GPU
+		bool isSmoothing() const { return smoothing; }
+		// bytes of point storage reserved by all trail renderers
+		static size_t getGlobalMemoryUsage();
 		void clearPoints(size_t trailID);
 		void clearPoints();
 		void setTrailPos(size_t trailID, const glm::vec4& pos, const glm::vec4& normal, const glm::vec4& tangent);
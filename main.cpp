@@ -4,6 +4,10 @@ using namespace fdm;
 
 #include "include/fxlib/FXLib.h"
 
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
 // Initialize the DLLMain
 initDLL
 
@@ -67,27 +71,46 @@ $hook(void, StateIntro, init, StateManager& s)
 	glClearColor(0.0, 0.0, 0.0, 0.0);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
-	glEnable(GL_BLEND);
 	glEnable(GL_ALPHA_TEST);
-	glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
-	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	// blending as 4D Miner sets it up. FXLib puts it back to this after changing it
+	FX::GLState::setBlend(FX::GLState::defaultBlend);
 
 	// load assets
 	allowedToLoadShaders = true;
 	ShaderManager::loadFromShaderList("shaderList.json");
 
-	FX::ParticleSystem::defaultShader = (const FX::Shader*)
-		ShaderManager::load("tr1ngledev.fxlib.particleShader",
+	// compiled in the background, everything using them waits for FX::ShaderLoader::isReady.
+	// they are still listed in ShaderManager under these names
+	FX::ParticleSystem::defaultShader =
+		FX::ShaderLoader::loadAsync("tr1ngledev.fxlib.particleShader",
 			"assets/shaders/particle.vert",
 			"assets/shaders/particle.frag",
 			"assets/shaders/particle.geom");
 
-	FX::TrailRenderer::defaultShader = (const FX::Shader*)
-		ShaderManager::load("tr1ngledev.fxlib.trailShader",
+	FX::TrailRenderer::defaultShader =
+		FX::ShaderLoader::loadAsync("tr1ngledev.fxlib.trailShader",
 			"assets/shaders/trail.vert",
 			"assets/shaders/trail.frag",
 			"assets/shaders/trail.geom");
 
+	FX::TrailBatch::defaultShader =
+		FX::ShaderLoader::loadAsync("tr1ngledev.fxlib.trailBatchShader",
+			"assets/shaders/trail_batch.vert",
+			"assets/shaders/trail.frag",
+			"assets/shaders/trail.geom");
+
+	FX::ParticleSystem::cullShader =
+		FX::ShaderLoader::loadComputeAsync("tr1ngledev.fxlib.particleCullShader",
+			"assets/shaders/particle_cull.comp");
+
+	FX::HiZ::buildShader =
+		FX::ShaderLoader::loadComputeAsync("tr1ngledev.fxlib.hiZBuildShader",
+			"assets/shaders/hiz_build.comp");
+
+	FX::TrailRenderer::smoothShader =
+		FX::ShaderLoader::loadComputeAsync("tr1ngledev.fxlib.trailSmoothShader",
+			"assets/shaders/trail_smooth.comp");
+
 	original(self, s);
 }
 
@@ -95,3 +118,19 @@ bool FX::hasInitializedContext()
 {
 	return initializedContext;
 }
+
+static std::atomic<bool> logging{ false };
+static std::unordered_set<std::string> loggedWarnings{ };
+static std::mutex logMutex{ };
+void FX::setLogging(bool enabled)
+{
+	logging = enabled;
+}
+void FX::logWarning(const std::string& message)
+{
+	if (!logging) return;
+
+	std::lock_guard lock{ logMutex };
+	if (!loggedWarnings.insert(message).second) return;
+	printf("FXLib: %s\n", message.c_str());
+}
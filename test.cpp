@@ -51,13 +51,17 @@ $hook(void, StateGame, init, StateManager& s)
 
 		particles.trails = true;
 		particles.setTrailBillboard(true);
-		particles.setTrailColorFunc([](float t, float p, size_t id, void* user)
+		particles.setTrailColorBatchFunc([](const float* t, const float* p, const size_t* ids, size_t count, glm::vec4* colors, void* user)
 			{
-				return ((FX::ParticleSystem*)user)->getParticleData()[id].color;
+				const auto& data = ((FX::ParticleSystem*)user)->getParticleData();
+				for (size_t i = 0; i < count; ++i)
+					colors[i] = data[ids[i]].color;
 			});
-		particles.setTrailWidthFunc([](float t, float p, size_t id, void* user)
+		particles.setTrailWidthBatchFunc([](const float* t, const float* p, const size_t* ids, size_t count, float* widths, void* user)
 			{
-				return ((FX::ParticleSystem*)user)->getParticleData()[id].scale.x * (p * (1.f - t));
+				const auto& data = ((FX::ParticleSystem*)user)->getParticleData();
+				for (size_t i = 0; i < count; ++i)
+					widths[i] = data[ids[i]].scale.x * (p[i] * (1.f - t[i]));
 			});
 		
 		MeshBuilder particleMesh = MeshBuilder{ BlockInfo::HYPERCUBE_FULL_INDEX_COUNT };